@@ -1,20 +1,36 @@
 #pragma once
 
+#include <chrono>
 #include <expected>
-#include <stack>
+#include <functional>
+#include <memory_resource>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "FXMLData.h"
 
+// Parse statistics are compiled out unless this is defined to 1, the CMake option of the same name does that for every user of the library
+#ifndef FXML_ENABLE_INSTRUMENTATION
+#define FXML_ENABLE_INSTRUMENTATION 0
+#endif
+
 namespace fxml
 {
+  template <typename Handler>
+  class Tokenizer;
+
+  class XMLCompressedReader;
+
   enum class ErrorReason
   {
     PARSE_ERROR = 0,
     CANNOT_OPEN_FILE = 1,
     CANNOT_FIND_FILE = 2,
-    BUFFER_TOO_SMALL = 3
+    BUFFER_TOO_SMALL = 3,
+    INVALID_ARGUMENT = 4,
+    INVALID_SNAPSHOT = 5
   };
 
   class XMLError
@@ -46,41 +62,221 @@ namespace fxml
     char* buffer;
     size_t bufferSize;
 
-    explicit Buffer(char* _buffer, size_t _bufferSize)
+    // When set, the document takes ownership of the buffer and hands it back through 'release' once it no longer needs it
+    std::function<void(char* buffer, size_t bufferSize)> release;
+
+    explicit Buffer(char* _buffer, size_t _bufferSize, std::function<void(char*, size_t)> _release = {})
       : buffer(_buffer)
       , bufferSize(_bufferSize)
+      , release(std::move(_release))
     {
     }
   };
 
+  struct MemoryMap
+  {
+    bool populate;    // Pre-fault every page of the mapping up front (MAP_POPULATE)
+    bool sequential;  // Hint the OS that the mapping will be read front to back (MADV_SEQUENTIAL)
+
+    explicit MemoryMap(bool _populate = false, bool _sequential = true)
+      : populate(_populate)
+      , sequential(_sequential)
+    {
+    }
+  };
+
+  struct AsyncRead
+  {
+    size_t chunkSize;     // Bytes per read, rounded up to whole pages. Every read starts at a multiple of it
+    uint32_t queueDepth;  // Reads in flight at once with io_uring, the fallback thread has one in flight at a time
+
+    explicit AsyncRead(size_t _chunkSize = 1024 * 1024, uint32_t _queueDepth = 4)
+      : chunkSize(_chunkSize)
+      , queueDepth(_queueDepth)
+    {
+    }
+  };
+
+  // Replaces the 'length' bytes at 'offset' of a document's text with 'replacement'
+  struct XMLEdit
+  {
+    size_t offset;
+    size_t length;
+    std::string_view replacement;
+  };
+
+#if FXML_ENABLE_INSTRUMENTATION
+  // Where the time of a parse went and what it produced, phases which do not apply to a parse stay at 0
+  struct XMLParseStats
+  {
+    std::chrono::nanoseconds loadTime{};      // Reading or memory-mapping the file
+    std::chrono::nanoseconds tokenizeTime{};  // Tokenizing, single-threaded parses link up the tree while doing so
+    std::chrono::nanoseconds buildTime{};     // Stitching chunks together, handing the arrays to the document and building its index
+    std::chrono::nanoseconds handOffTime{};   // Giving the document ownership of its source text
+
+    size_t nrOfElements{};
+    size_t nrOfAttributes{};
+    size_t nrOfComments{};
+    size_t nrOfTextNodes{};
+    size_t maxDepth{};
+
+    // Parallel parses count the chunks that had to be parsed again twice
+    size_t bytesScanned{};
+
+    // Taken from the memory resource and still held by the document: node arrays and, when the parser allocated it, the source text
+    size_t bytesAllocated{};
+  };
+#endif
+
+  struct ParseOptions
+  {
+    // Build the name/attribute index of the document as part of the parse, instead of on its first lookup
+    bool buildIndex = false;
+
+    // Documents of at least 'minChunkSize' bytes per thread get split over up to 'threadCount' threads, 0 uses every hardware thread
+    // The resulting document is the same as the one a single thread builds
+    uint32_t threadCount = 1;
+    size_t minChunkSize = 1024 * 1024;
+
+    // Where the node and attribute arrays and the file contents of every document get allocated, nullptr is the default resource
+    // With an XMLArena that gets reset between documents, parsing from memory does not touch the heap once the arena is warm
+    // XMLBatchParser workers and concurrent GetContent calls allocate from it on several threads, so it has to be thread-safe like XMLArena
+    std::pmr::memory_resource* memoryResource = nullptr;
+
+    // Only elements on one of these paths get built, each with its whole subtree, and they become the top-level elements of the document
+    // Paths use the XMLQuery syntax without predicates, e.g. '/catalog/record/price', '//price' or 'price'. Everything else is only scanned
+    // for tag boundaries, its attributes and text are never lexed. Filtered parses run on a single thread, empty builds the whole document
+    std::vector<std::string> filter{};
+
+#if FXML_ENABLE_INSTRUMENTATION
+    // Called at the end of every parse, failed ones included
+    std::function<void(XMLParseStats const& stats)> onStats{};
+#endif
+  };
+
   class XMLParser
   {
    private:
-    char* m_buffer = nullptr;
-    size_t m_bufferSize = 0;
+    struct OpenElement
+    {
+      uint32_t index;      // Element this entry will be closed against
+      uint32_t lastChild;  // Most recently added child, the next child becomes its sibling
+    };
+
+    struct FilterStep
+    {
+      bool descendant;   // At any depth below the previous step rather than right below it
+      std::string name;  // "*" matches any name
+    };
+
+   private:
+    ParseOptions m_options;
+
+    // State of the parse in progress, cleared at the start of every parse so a parser can be reused
     size_t m_bufferPointer = 0;
-    std::stack<XMLElement> m_elementStack;
-    std::vector<XMLElement> m_elements;
+    std::vector<OpenElement> m_elementStack;
+    uint32_t m_lastTopLevelElement = XMLElement::INVALID_INDEX;
+    std::pmr::vector<XMLElement> m_elements;
+    std::pmr::vector<XMLAttribute> m_attributes;
+    XMLNameTable m_names;
+
+    // ID of the key at each attribute position of the start tags so far, only used to skip interning keys seen at that position before
+    std::vector<uint32_t> m_lastKeyIds;
+
+    // 'ParseOptions::filter' compiled on the first filtered parse, and the names of the elements a filtered parse is skipping over
+    std::vector<std::vector<FilterStep>> m_filterPaths;
+    bool m_filterCompiled = false;
+    std::vector<std::string_view> m_skippedElementStack;
+
+#if FXML_ENABLE_INSTRUMENTATION
+    XMLParseStats m_stats;
+#endif
 
    public:
-    ~XMLParser();
+    XMLParser();
+    explicit XMLParser(ParseOptions const& options);
+
+    // Drops whatever is left of the previous parse, every parse starts with a Reset(). Scratch state such as the element stack keeps its
+    // capacity, the node arrays do not: they went to the previous document, so every parse allocates its own from the memory resource
+    void Reset();
 
-    // Parser will allocate buffer according to filesize
+    // Parser will allocate buffer according to filesize, the document owns the buffer
     std::expected<XMLDocument, XMLError> Parse(std::string_view filepath);
 
-    // Parser will use a user-provided buffer
+    // Parser will use a user-provided buffer, which must outlive the document unless it comes with a release function
     std::expected<XMLDocument, XMLError> Parse(std::string_view filepath, Buffer const& buffer);
 
+    // Parser will memory-map the file read-only, the document will point straight into the mapping and keep it alive
+    std::expected<XMLDocument, XMLError> Parse(std::string_view filepath, MemoryMap const& options);
+
+    // Parser will read the file in chunks in the background, io_uring where the build found it and a thread otherwise, and tokenizes every
+    // chunk as soon as it is in. The document owns the buffer. Filtered and multi-threaded parses need the whole text, those wait for all of it
+    std::expected<XMLDocument, XMLError> Parse(std::string_view filepath, AsyncRead const& options);
+
+    // Parser will decompress a gzip or zstd file on a second thread while it tokenizes what is decompressed so far, the document owns the
+    // uncompressed text. Plain files work as well. Filtered and multi-threaded parses need the whole text, those decompress it all first
+    std::expected<XMLDocument, XMLError> ParseCompressed(std::string_view filepath);
+
+    // Parser will parse straight from caller-owned memory, the caller's memory must outlive the document
+    std::expected<XMLDocument, XMLError> ParseFromMemory(std::string_view xml);
+
+    /*
+    Applies 'edit' to the text of 'document' and parses only the smallest element that encloses it, everything else is kept and moved along
+    The edited text is a new buffer owned by the document. An edit outside of every element's content parses the whole text again
+    On failure the document is left as it was
+    */
+    std::expected<void, XMLError> Reparse(XMLDocument& document, XMLEdit const& edit);
+
+    // Same, for a document which points into caller-owned 'text', e.g. one parsed from memory. 'text' is not changed
+    // Documents of a filtered parse only hold part of their text's elements, they cannot be re-parsed, nor can a filtered parser re-parse
+    std::expected<void, XMLError> Reparse(XMLDocument& document, std::string_view text, XMLEdit const& edit);
+
+#if FXML_ENABLE_INSTRUMENTATION
+    // Statistics of the last parse
+    XMLParseStats const& GetStats() const;
+#endif
+
    private:
-    std::expected<XMLDocument, XMLError> ParseImpl(std::string_view filepath);
-
-    // =============================
-    // ====== PARSE FUNCTIONS ======
-    // =============================
-    std::expected<void, XMLError> ParseDocument(std::string_view const buffer, size_t bufferSize, size_t& bufferPointer);
-    std::expected<void, XMLError> ParseStartTag(std::string_view const buffer, size_t& bufferPointer);
-    std::expected<void, XMLError> ParseEndTag(std::string_view buffer, size_t& bufferPointer);
-    std::expected<void, XMLError> ParseContent(std::string_view buffer, size_t& bufferPointer);
-    std::expected<void, XMLError> ParseComment(std::string_view buffer, size_t& bufferPointer);
+    std::expected<XMLDocument, XMLError> ParseImpl(std::string_view filepath, std::span<char> buffer);
+    XMLDocument AttachSource(XMLDocument&& doc, XMLSource&& source);
+    std::expected<XMLDocument, XMLError> ParseBuffer(std::string_view buffer);
+
+    // Hands the tokenized arrays over to a new document, once every element is closed
+    std::expected<XMLDocument, XMLError> BuildDocument();
+
+    // Tokenizes the bytes of 'reader' as they come in, into a buffer which grows when the size hint falls short
+    std::expected<XMLDocument, XMLError> ParseStream(XMLCompressedReader& reader);
+    void RebaseViews(char const* from, size_t size, char const* to);
+
+    // Tokenizes the chunks on their own threads and stitches the partial trees together afterwards
+    class ChunkBuilder;
+    std::expected<XMLDocument, XMLError> ParseBufferParallel(std::string_view buffer, size_t nrOfChunks);
+
+    // Builds only the subtrees 'ParseOptions::filter' selects, the elements around them are skipped with a bracket scan
+    std::expected<XMLDocument, XMLError> ParseBufferFiltered(std::string_view buffer);
+    std::expected<void, XMLError> CompileFilter();
+    bool MatchesFilter() const;
+    static bool MatchesFilterPath(std::span<FilterStep const> steps, std::span<std::string_view const> names);
+
+    // Parses the content of a single element for Reparse
+    class SubtreeBuilder;
+
+#if FXML_ENABLE_INSTRUMENTATION
+    void CollectStats(std::pmr::vector<XMLElement> const& elements, std::pmr::vector<XMLAttribute> const& attributes);
+    void ReportStats() const;
+#endif
+
+    // ==============================
+    // ====== TOKENIZER EVENTS ======
+    // ==============================
+    template <typename Handler>
+    friend class Tokenizer;
+
+    std::pmr::vector<XMLAttribute>& GetAttributeStorage();
+    bool HasOpenElement() const;
+    std::expected<void, XMLError> OnStartTag(std::string_view name, std::span<XMLAttribute const> attributes, bool isEmptyElement);
+    std::expected<void, XMLError> OnEndTag(std::string_view name);
+    std::expected<void, XMLError> OnContent(std::string_view content);
+    std::expected<void, XMLError> OnComment(std::string_view comment);
   };
 }  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace fxml
+{
+  /*
+  Monotonic memory resource for documents which are thrown away together, e.g. one per request in a service
+  Deallocating is a no-op, Reset() takes back every allocation at once but keeps the memory for the next round
+
+  Allocating is thread-safe, so one arena can back the workers of an XMLBatchParser and documents decoding on several threads at once
+  Reset() is not: nothing may be using the arena or a document built on it while it runs
+  */
+  class XMLArena : public std::pmr::memory_resource
+  {
+   public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+   private:
+    struct Block
+    {
+      std::byte* data;
+      size_t size;
+    };
+
+   private:
+    std::pmr::memory_resource* m_upstream;
+    size_t m_blockSize;
+
+    // Uncontended in the common single-threaded case, and an arena only allocates a handful of times per document
+    mutable std::mutex m_mutex;
+    std::vector<Block> m_blocks;
+    size_t m_currentBlock = 0;
+    size_t m_offset = 0;
+    size_t m_bytesUsed = 0;
+
+   public:
+    explicit XMLArena(size_t blockSize = DEFAULT_BLOCK_SIZE, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~XMLArena() override;
+
+    XMLArena(XMLArena const&) = delete;
+    XMLArena& operator=(XMLArena const&) = delete;
+
+    // Everything allocated from the arena so far becomes invalid, including documents built on it
+    // Multiple blocks are merged into one, so a round of the same size as the previous one fits without going upstream
+    void Reset();
+
+    size_t GetCapacity() const;
+    size_t GetBytesUsed() const;
+
+   private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    // Callers hold 'm_mutex'
+    void* Allocate(size_t bytes, size_t alignment);
+    size_t SumBlockSizes() const;
+    void Release();
+  };
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  /*
+  Parses many files on a fixed pool of worker threads, each worker keeps its own XMLParser around for every file it gets
+  Files are handed out to the workers in contiguous runs, a worker which runs out steals from the back of another worker's run
+  */
+  class XMLBatchParser
+  {
+   private:
+    struct Worker
+    {
+      std::mutex mutex;
+      std::deque<size_t> tasks;  // Indices into the current batch, the owner takes from the front and thieves from the back
+      XMLParser parser;
+      std::jthread thread;
+
+      explicit Worker(ParseOptions const& options);
+    };
+
+   private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    // Only one batch runs at a time
+    std::mutex m_batchMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_batchDone;
+    uint64_t m_batch = 0;
+    bool m_stop = false;
+
+    std::span<std::string_view const> m_filepaths;
+    std::vector<std::expected<XMLDocument, XMLError>>* m_results = nullptr;
+    std::atomic<size_t> m_remaining = 0;
+
+   public:
+    // 0 threads uses every hardware thread
+    explicit XMLBatchParser(uint32_t threadCount = 0, ParseOptions const& options = {});
+    ~XMLBatchParser();
+
+    XMLBatchParser(XMLBatchParser const&) = delete;
+    XMLBatchParser& operator=(XMLBatchParser const&) = delete;
+
+    // The result at index i belongs to the file at index i
+    std::vector<std::expected<XMLDocument, XMLError>> ParseMany(std::span<std::string_view const> filepaths);
+    std::vector<std::expected<XMLDocument, XMLError>> ParseMany(std::span<std::string const> filepaths);
+
+    size_t GetNrOfThreads() const;
+
+   private:
+    void WorkerLoop(size_t workerIndex);
+    std::optional<size_t> NextTask(size_t workerIndex);
+  };
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FXML.h"
+
+namespace fxml
+{
+  /*
+  Binds a struct to XML, specialize it once per struct:
+
+    template <>
+    struct fxml::XMLBinding<Server>
+    {
+      static constexpr std::string_view name = "server";
+      static constexpr auto fields = std::tuple{fxml::Attribute("host", &Server::host), fxml::Element("port", &Server::port)};
+    };
+
+  Elements bind to the text of a child element, attributes to an attribute of the element itself
+  Members may be std::string, std::string_view (the raw text, a view into the input), bool, any arithmetic type,
+  another bound struct, or a std::vector of any of those for elements which repeat. Unbound elements and attributes are skipped
+  */
+  template <typename T>
+  struct XMLBinding;
+
+  template <typename T, typename Member>
+  struct XMLFieldBinding
+  {
+    std::string_view name;
+    Member T::*member;
+    bool isAttribute;
+  };
+
+  template <typename T, typename Member>
+  constexpr XMLFieldBinding<T, Member> Element(std::string_view name, Member T::*member)
+  {
+    return XMLFieldBinding<T, Member>{name, member, false};
+  }
+
+  template <typename T, typename Member>
+  constexpr XMLFieldBinding<T, Member> Attribute(std::string_view name, Member T::*member)
+  {
+    return XMLFieldBinding<T, Member>{name, member, true};
+  }
+
+  namespace detail
+  {
+    template <typename T>
+    concept BoundStruct = requires {
+      XMLBinding<T>::name;
+      XMLBinding<T>::fields;
+    };
+
+    template <typename T>
+    struct IsVector : std::false_type
+    {
+    };
+
+    template <typename T, typename Allocator>
+    struct IsVector<std::vector<T, Allocator>> : std::true_type
+    {
+    };
+
+    enum class BoundFieldKind : uint8_t
+    {
+      ELEMENT = 0,
+      ATTRIBUTE = 1
+    };
+
+    struct BindingTable;
+
+    using SetBoundField = std::expected<void, XMLError> (*)(void* object, std::string_view text);
+    using BindChild = void* (*)(void* object);
+    using GetBindingTable = BindingTable const& (*)();
+
+    struct BoundField
+    {
+      std::string_view name;
+      BoundFieldKind kind;
+      bool rawText;                // std::string_view members get the text as it is in the input, without decoding references
+      SetBoundField set;           // Scalars
+      BindChild child;             // Bound structs, returns the struct to fill (a new one for vectors)
+      GetBindingTable childTable;  // Bound structs
+    };
+
+    constexpr uint32_t HashBoundField(std::string_view name, BoundFieldKind kind, uint32_t seed)
+    {
+      uint32_t hash = (2166136261u ^ seed) * 16777619u;
+      hash = (hash ^ static_cast<uint8_t>(kind)) * 16777619u;
+      for (char const c : name)
+      {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+      }
+
+      // The low bits pick the slot, but FNV only carries changes upwards, so fold the high bits back in (murmur3 finalizer)
+      hash ^= hash >> 16;
+      hash *= 0x85ebca6bu;
+      hash ^= hash >> 13;
+      hash *= 0xc2b2ae35u;
+      hash ^= hash >> 16;
+
+      return hash;
+    }
+
+    // Every field of a struct lands in its own slot, a lookup is one hash and one name compare
+    struct BindingTable
+    {
+      std::string_view name;
+      std::span<BoundField const> fields;
+      std::span<uint8_t const> slots;  // Field index + 1, 0 for an empty slot
+      uint32_t seed;
+
+      BoundField const* Find(std::string_view fieldName, BoundFieldKind kind) const
+      {
+        if (slots.empty())
+        {
+          return nullptr;
+        }
+
+        uint8_t const slot = slots[HashBoundField(fieldName, kind, seed) & (slots.size() - 1)];
+        if (slot == 0)
+        {
+          return nullptr;
+        }
+
+        BoundField const& field = fields[slot - 1];
+        return field.kind == kind && field.name == fieldName ? &field : nullptr;
+      }
+    };
+
+    template <size_t TableSize>
+    struct PerfectHash
+    {
+      uint32_t seed = 0;
+      std::array<uint8_t, TableSize> slots{};
+    };
+
+    // Tries seeds until no two fields share a slot, at compile time
+    template <size_t TableSize, size_t N>
+    constexpr PerfectHash<TableSize> BuildPerfectHash(std::array<BoundField, N> const& fields)
+    {
+      static_assert(N < 255, "Too many fields in one binding");
+
+      for (uint32_t seed{}; seed < (1u << 16); ++seed)
+      {
+        PerfectHash<TableSize> hash{seed, {}};
+        bool collision = false;
+        for (size_t i{}; i < N && !collision; ++i)
+        {
+          uint8_t& slot = hash.slots[HashBoundField(fields[i].name, fields[i].kind, seed) & (TableSize - 1)];
+          collision = slot != 0;
+          slot = static_cast<uint8_t>(i + 1);
+        }
+
+        if (!collision)
+        {
+          return hash;
+        }
+      }
+
+      throw "No perfect hash found, are two fields bound to the same name?";
+    }
+
+    template <typename Member>
+    std::expected<void, XMLError> ConvertBoundText(std::string_view text, Member& member)
+    {
+      // Whitespace around a number or boolean carries no meaning
+      if constexpr (std::is_arithmetic_v<Member>)
+      {
+        size_t const first = text.find_first_not_of(" \t\r\n");
+        text = first == std::string_view::npos ? std::string_view{} : text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+      }
+
+      if constexpr (std::is_same_v<Member, std::string> || std::is_same_v<Member, std::string_view>)
+      {
+        member = Member{text};
+      }
+      else if constexpr (std::is_same_v<Member, bool>)
+      {
+        if (text == "true" || text == "1")
+        {
+          member = true;
+        }
+        else if (text == "false" || text == "0")
+        {
+          member = false;
+        }
+        else
+        {
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("'{}' is not a boolean", text)}};
+        }
+      }
+      else if constexpr (std::is_arithmetic_v<Member>)
+      {
+        auto const [end, ec] = std::from_chars(text.data(), text.data() + text.size(), member);
+        if (ec != std::errc{} || end != text.data() + text.size())
+        {
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("'{}' is not a valid number for this field", text)}};
+        }
+      }
+      else
+      {
+        static_assert(std::is_arithmetic_v<Member>, "Unsupported member type in XMLBinding");
+      }
+
+      return {};
+    }
+
+    template <typename T, size_t I>
+    std::expected<void, XMLError> SetBoundMember(void* object, std::string_view text)
+    {
+      auto& member = static_cast<T*>(object)->*(std::get<I>(XMLBinding<T>::fields).member);
+      if constexpr (IsVector<std::remove_cvref_t<decltype(member)>>::value)
+      {
+        return ConvertBoundText(text, member.emplace_back());
+      }
+      else
+      {
+        return ConvertBoundText(text, member);
+      }
+    }
+
+    template <typename T, size_t I>
+    void* BindChildMember(void* object)
+    {
+      auto& member = static_cast<T*>(object)->*(std::get<I>(XMLBinding<T>::fields).member);
+      if constexpr (IsVector<std::remove_cvref_t<decltype(member)>>::value)
+      {
+        return &member.emplace_back();
+      }
+      else
+      {
+        return &member;
+      }
+    }
+
+    template <typename T>
+    struct BindingTableFor;
+
+    template <typename T, size_t I>
+    constexpr BoundField MakeBoundField()
+    {
+      constexpr auto binding = std::get<I>(XMLBinding<T>::fields);
+      using Member = std::remove_cvref_t<decltype(std::declval<T&>().*(binding.member))>;
+      using Value = typename std::conditional_t<IsVector<Member>::value, Member, std::vector<Member>>::value_type;
+
+      BoundField field{binding.name, binding.isAttribute ? BoundFieldKind::ATTRIBUTE : BoundFieldKind::ELEMENT, std::is_same_v<Value, std::string_view>,
+                       nullptr, nullptr, nullptr};
+      if constexpr (BoundStruct<Value>)
+      {
+        static_assert(!binding.isAttribute, "A bound struct can only be bound to an element");
+        field.child = &BindChildMember<T, I>;
+        field.childTable = &BindingTableFor<Value>::Get;
+      }
+      else
+      {
+        field.set = &SetBoundMember<T, I>;
+      }
+
+      return field;
+    }
+
+    template <typename T>
+    struct BindingTableFor
+    {
+      static constexpr size_t NR_OF_FIELDS = std::tuple_size_v<decltype(XMLBinding<T>::fields)>;
+      static constexpr auto fields = []<size_t... I>(std::index_sequence<I...>)
+      { return std::array<BoundField, sizeof...(I)>{MakeBoundField<T, I>()...}; }(std::make_index_sequence<NR_OF_FIELDS>{});
+
+      static constexpr size_t TABLE_SIZE = std::bit_ceil(std::max<size_t>(fields.size() * 2, 1));
+      static constexpr PerfectHash<TABLE_SIZE> hash = BuildPerfectHash<TABLE_SIZE>(fields);
+
+      static BindingTable const& Get()
+      {
+        static constexpr BindingTable table{XMLBinding<T>::name, fields, hash.slots, hash.seed};
+        return table;
+      }
+    };
+
+    // Drives the shared tokenizer with 'table', no document gets built
+    std::expected<void, XMLError> ParseBound(std::string_view xml, void* object, BindingTable const& table);
+  }  // namespace detail
+
+  // Fills 'object' from 'xml', members which do not show up in the XML keep their value
+  template <detail::BoundStruct T>
+  std::expected<void, XMLError> ParseInto(std::string_view xml, T& object)
+  {
+    return detail::ParseBound(xml, &object, detail::BindingTableFor<T>::Get());
+  }
+
+  template <detail::BoundStruct T>
+  std::expected<T, XMLError> ParseInto(std::string_view xml)
+  {
+    T object{};
+    if (auto const ret = ParseInto(xml, object); !ret.has_value())
+    {
+      return std::unexpected{ret.error()};
+    }
+
+    return object;
+  }
+}  // namespace fxml
\ No newline at end of file
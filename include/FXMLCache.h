@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  /*
+  Keeps parsed files around and hands out the same immutable document until the file changes
+  A file counts as changed once its size or last write time differs from when it was parsed. Every Get checks that, unless the file is
+  being watched: with 'watchFiles' the cache gets told about changes by the OS (inotify, Linux only) and hits do not touch the file system
+
+  Safe to use from multiple threads. Threads asking for the same file while it is being parsed all wait for that one parse
+  Documents handed out come with their index built, so index lookups on them never write. They stay valid after they got replaced, the last holder
+  frees them
+  */
+  class XMLDocumentCache
+  {
+   public:
+    using DocumentPtr = std::shared_ptr<XMLDocument const>;
+
+   private:
+    using PendingDocument = std::shared_future<std::expected<DocumentPtr, XMLError>>;
+
+    struct Entry
+    {
+      size_t size;
+      std::filesystem::file_time_type lastWriteTime;
+      uint64_t generation;       // Tells a replaced entry apart from the one a parse was started for
+      PendingDocument document;  // Ready once the parse is done
+      bool watched;              // Any change to the file removes the entry, so it does not have to be checked
+    };
+
+    class Watcher;
+
+   private:
+    ParseOptions m_options;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    uint64_t m_nextGeneration = 0;
+    uint64_t m_nrOfInvalidations = 0;
+
+    // Last, its thread calls Invalidate and has to be gone before anything else
+    std::unique_ptr<Watcher> m_watcher;
+
+   public:
+    // Documents get parsed with 'options', its memory resource must outlive every document the cache hands out
+    explicit XMLDocumentCache(ParseOptions const& options = {}, bool watchFiles = false);
+    ~XMLDocumentCache();
+
+    XMLDocumentCache(XMLDocumentCache const&) = delete;
+    XMLDocumentCache& operator=(XMLDocumentCache const&) = delete;
+
+    // Parses the file on the first call and again whenever it changed, every other call shares the cached document
+    std::expected<DocumentPtr, XMLError> Get(std::string_view filepath);
+
+    // The next Get of the file parses it again
+    void Invalidate(std::string_view filepath);
+    void Clear();
+
+    size_t GetNrOfDocuments() const;
+
+    // False when watching was not asked for or is not supported, hits then check the file every time
+    bool IsWatchingFiles() const;
+  };
+}  // namespace fxml
\ No newline at end of file
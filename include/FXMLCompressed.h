@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <expected>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "FXML.h"
+
+namespace fxml
+{
+  enum class Compression
+  {
+    NONE = 0,
+    GZIP = 1,
+    ZSTD = 2
+  };
+
+  /*
+  Reads a gzip (.gz) or zstd (.zst) compressed file as its uncompressed bytes, the format is taken from the magic number at its start
+  A background thread decompresses at most 'nrOfBlocks' blocks of 'blockSize' ahead of the reader, so memory use does not depend on the
+  uncompressed size and decompressing overlaps with whatever the reader does with the bytes. Files with neither magic number are read as is
+
+  Formats whose library was not found at build time fail to open with ErrorReason::INVALID_ARGUMENT, see IsSupported
+  */
+  class XMLCompressedReader
+  {
+   public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+    static constexpr size_t DEFAULT_NR_OF_BLOCKS = 4;
+
+   private:
+    // One per format, lives in the translation unit so the compression libraries stay out of this header
+    class Decoder;
+
+    struct Block
+    {
+      std::vector<char> data;
+      size_t size;
+    };
+
+   private:
+    size_t m_blockSize;
+    Compression m_compression = Compression::NONE;
+    size_t m_sizeHint = 0;
+
+    // Ring of blocks, the ready ones start at 'm_firstReadyBlock' and the decompressor fills the one right behind them
+    std::mutex m_mutex;
+    std::condition_variable m_blockReady;
+    std::condition_variable m_blockFree;
+    std::vector<Block> m_blocks;
+    size_t m_firstReadyBlock = 0;
+    size_t m_nrOfReadyBlocks = 0;
+    bool m_finished = false;
+    bool m_stop = false;
+    std::optional<XMLError> m_error;
+
+    // Bytes of the first ready block the reader already took, only touched by the reading thread
+    size_t m_readOffset = 0;
+
+    // Last, it has to be gone before anything it uses
+    std::jthread m_thread;
+
+   public:
+    explicit XMLCompressedReader(size_t blockSize = DEFAULT_BLOCK_SIZE, size_t nrOfBlocks = DEFAULT_NR_OF_BLOCKS);
+    ~XMLCompressedReader();
+
+    XMLCompressedReader(XMLCompressedReader const&) = delete;
+    XMLCompressedReader& operator=(XMLCompressedReader const&) = delete;
+
+    // Whether this build can decompress 'compression'
+    static bool IsSupported(Compression compression);
+
+    // Starts decompressing 'filepath' in the background, a file which is still open gets closed first
+    std::expected<void, XMLError> Open(std::string_view filepath);
+    void Close();
+
+    // Same contract as XMLSaxParser::ChunkReader: fills 'chunk' with the next uncompressed bytes and returns how many, 0 at the end
+    // Only waits for the decompressor when nothing at all is ready, so the caller gets to work on what is there
+    std::expected<size_t, XMLError> Read(std::span<char> chunk);
+
+    Compression GetCompression() const;
+
+    // Uncompressed size as the file records it, 0 if it does not. Only a hint: gzip stores the size of its last member, modulo 4 GiB, and
+    // sizes far beyond what the compressed size can plausibly hold get capped, as they are more likely a crafted header than a real file
+    size_t GetSizeHint() const;
+
+   private:
+    void DecompressLoop(std::ifstream file, std::unique_ptr<Decoder> decoder, std::string filepath);
+  };
+}  // namespace fxml
@@ -1,13 +1,87 @@
 #pragma once
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace fxml
 {
+  /*
+  Gives every distinct tag and attribute name of a document a dense ID, in order of first appearance
+  Names are copied into the table, so an ID stays valid for as long as the document lives, Reparse included
+  */
+  class XMLNameTable
+  {
+   public:
+    static constexpr uint32_t INVALID_ID = std::numeric_limits<uint32_t>::max();
+
+   private:
+    // Every name back to back, name 'id' spans [m_offsets[id], m_offsets[id + 1])
+    std::pmr::string m_text;
+    std::pmr::vector<uint32_t> m_offsets;
+
+    // Open addressing on the hash of the name, a slot holds an ID or INVALID_ID. No pointers, so copies and moves need no fix-ups
+    std::pmr::vector<uint32_t> m_slots;
+
+   public:
+    explicit XMLNameTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    XMLNameTable(XMLNameTable const& other, std::pmr::memory_resource* resource);
+
+    // Returns the ID of 'name', which gets added if it is not in the table yet
+    uint32_t Intern(std::string_view name);
+
+    // INVALID_ID if 'name' is not in the table
+    uint32_t Find(std::string_view name) const;
+    std::string_view GetName(uint32_t id) const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+   private:
+    void Rehash(size_t nrOfSlots);
+  };
+
+  struct XMLAttribute
+  {
+    std::string_view key;
+    std::string_view value;
+  };
+
+  // Non-owning view over the attributes of one element, which are stored contiguously in the owning document
+  class XMLAttributes
+  {
+   private:
+    std::span<XMLAttribute const> m_attributes;
+
+   public:
+    XMLAttributes() = default;
+    explicit XMLAttributes(std::span<XMLAttribute const> attributes);
+
+    // Mirrors the std::map interface attributes used to be stored in
+    bool contains(std::string_view key) const;
+    std::string_view at(std::string_view key) const;
+    std::optional<std::string_view> find(std::string_view key) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    std::span<XMLAttribute const>::iterator begin() const;
+    std::span<XMLAttribute const>::iterator end() const;
+  };
+
   /*
   <node name="FXML">
           <child>This is content</child>
@@ -17,44 +91,271 @@ namespace fxml
   struct XMLTag
   {
     std::string_view name;
-    std::map<std::string_view, std::string_view> attributes;
+    XMLAttributes attributes;
   };
 
+  // A single node in the document's flat node array, all links are indices into that same array
   class XMLElement
   {
    private:
     friend class XMLParser;
+    friend class XMLDocument;
+    friend class XMLQuery;
+    friend class XMLSiblingIterator;
+    friend class XMLSnapshot;
+
+   public:
+    static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
 
    private:
     XMLTag m_tag;
-    std::vector<XMLElement> m_children;
     std::string_view m_rawContent;
+    uint32_t m_parent = INVALID_INDEX;
+    uint32_t m_firstChild = INVALID_INDEX;
+    uint32_t m_nextSibling = INVALID_INDEX;
+
+    // Range in the document's attribute array, 'm_tag.attributes' is bound to it once the document owns the array
+    uint32_t m_attributeOffset = 0;
+    uint32_t m_attributeCount = 0;
+
+    uint32_t m_nameId = XMLNameTable::INVALID_ID;
 
    public:
     XMLTag const& GetTag() const;
     std::string_view GetRawContent() const;
 
+    // ID of the tag name in the name table of the owning document
+    uint32_t GetNameId() const;
+
    private:
-    XMLElement(XMLTag const&& tag);
+    XMLElement(std::string_view name, uint32_t attributeOffset, uint32_t attributeCount);
 
     void SetRawContent(std::string_view content);
   };
 
+  // Walks a chain of next-sibling links through a document's flat node array
+  class XMLSiblingIterator
+  {
+   private:
+    std::span<XMLElement const> m_elements;
+    uint32_t m_index = XMLElement::INVALID_INDEX;
+
+   public:
+    using value_type = XMLElement;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    XMLSiblingIterator() = default;
+    XMLSiblingIterator(std::span<XMLElement const> elements, uint32_t index);
+
+    XMLElement const& operator*() const;
+    XMLElement const* operator->() const;
+    XMLSiblingIterator& operator++();
+    XMLSiblingIterator operator++(int);
+    bool operator==(XMLSiblingIterator const& other) const;
+  };
+
+  struct XMLSiblingRange
+  {
+    XMLSiblingIterator first;
+
+    XMLSiblingIterator begin() const;
+    XMLSiblingIterator end() const;
+  };
+
+  // Iterates a list of element indices, e.g. the result of an index lookup
+  class XMLIndexIterator
+  {
+   private:
+    std::span<XMLElement const> m_elements;
+    uint32_t const* m_index = nullptr;
+
+   public:
+    using value_type = XMLElement;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    XMLIndexIterator() = default;
+    XMLIndexIterator(std::span<XMLElement const> elements, uint32_t const* index);
+
+    XMLElement const& operator*() const;
+    XMLElement const* operator->() const;
+    XMLIndexIterator& operator++();
+    XMLIndexIterator operator++(int);
+    bool operator==(XMLIndexIterator const& other) const;
+  };
+
+  class XMLIndexRange
+  {
+   private:
+    std::span<XMLElement const> m_elements;
+    std::span<uint32_t const> m_indices;
+
+   public:
+    XMLIndexRange() = default;
+    XMLIndexRange(std::span<XMLElement const> elements, std::span<uint32_t const> indices);
+
+    XMLIndexIterator begin() const;
+    XMLIndexIterator end() const;
+
+    size_t size() const;
+    bool empty() const;
+  };
+
+  // Owns the text a document's views point into, and gives it back through 'release' once the document is gone
+  class XMLSource
+  {
+   public:
+    using ReleaseFunction = std::function<void(char const* data, size_t size)>;
+
+   private:
+    char const* m_data = nullptr;
+    size_t m_size = 0;
+    ReleaseFunction m_release;
+
+   public:
+    XMLSource() = default;
+    XMLSource(char const* data, size_t size, ReleaseFunction release);
+    ~XMLSource();
+
+    XMLSource(XMLSource const&) = delete;
+    XMLSource(XMLSource&& other) noexcept;
+    XMLSource& operator=(XMLSource const&) = delete;
+    XMLSource& operator=(XMLSource&& other) noexcept;
+
+    std::string_view GetText() const;
+  };
+
+  // Move-only, a document owns its node arrays and (unless the caller kept it) the text they point into
   class XMLDocument
   {
    private:
     friend class XMLParser;
+    friend class XMLQuery;
+    friend class XMLSnapshot;
+
+    // Offset and count into one of the index's entry arrays
+    struct IndexRange
+    {
+      uint32_t offset;
+      uint32_t count;
+    };
+
+    struct AttributeHash
+    {
+      size_t operator()(std::pair<std::string_view, std::string_view> const& attribute) const;
+    };
+
+    // Every element index grouped per name ID (or attribute key/value pair), in document order within each group
+    struct Index
+    {
+      std::vector<IndexRange> names;
+      std::vector<uint32_t> nameEntries;
+      std::unordered_map<std::pair<std::string_view, std::string_view>, IndexRange, AttributeHash> attributes;
+      std::vector<uint32_t> attributeEntries;
+    };
+
+    // Start and length of a raw view, two views starting at the same byte are only the same text when their lengths match too
+    using DecodeKey = std::pair<char const*, size_t>;
+
+    struct DecodeKeyHash
+    {
+      size_t operator()(DecodeKey const& key) const;
+    };
+
+    // Decoded text per raw view of this document
+    struct DecodeCache
+    {
+      std::mutex mutex;
+      std::pmr::unordered_map<DecodeKey, std::pmr::string, DecodeKeyHash> values;
+
+      explicit DecodeCache(std::pmr::memory_resource* resource);
+    };
+
+    struct DecodeCacheDeleter
+    {
+      std::pmr::memory_resource* resource;
+
+      void operator()(DecodeCache* cache) const;
+    };
 
    private:
-    std::vector<XMLElement> m_elements;
+    // Every element in document order, followed by every attribute of every element, also in document order
+    std::pmr::vector<XMLElement> m_elements;
+    std::pmr::vector<XMLAttribute> m_attributes;
+
+    // Every name of 'm_elements' and 'm_attributes', only ever grows so IDs handed out stay valid
+    XMLNameTable m_names;
+
+    // Built on first lookup, or while parsing with ParseOptions::buildIndex
+    mutable std::unique_ptr<Index> m_index;
+
+    // Lives in the same memory resource as the node arrays, so documents without references never touch the heap for it
+    std::unique_ptr<DecodeCache, DecodeCacheDeleter> m_decodeCache;
+
+    // The parsed text every view points into, empty when the caller owns it
+    XMLSource m_source;
+
+    // Built by a filtered parse, so it only holds part of its text's elements
+    bool m_filtered = false;
 
    public:
+    XMLDocument() = default;
+    XMLDocument(XMLDocument const&) = delete;
+    XMLDocument(XMLDocument&& other) noexcept = default;
+    XMLDocument& operator=(XMLDocument const&) = delete;
+    XMLDocument& operator=(XMLDocument&& other);
+
+    // Deep copy, including the source text when the document owns it. The index is not copied, it gets built again when needed
+    XMLDocument Clone() const;
+
     std::optional<std::reference_wrapper<XMLElement const>> GetNodeByName(std::string_view tagName);
     std::optional<std::reference_wrapper<XMLElement const>> GetNodeByIndex(uint32_t index) const;
 
+    // Names resolved to IDs once, after which every lookup compares integers. INVALID_ID means no element or attribute has that name
+    XMLNameTable const& GetNames() const;
+    uint32_t GetNameId(std::string_view name) const;
+    std::optional<std::reference_wrapper<XMLElement const>> GetNodeByName(uint32_t nameId) const;
+
+    // Index lookups, the index is built on the first call so build it up front if the document is shared between threads
+    XMLIndexRange GetNodesByName(std::string_view tagName) const;
+    XMLIndexRange GetNodesByName(uint32_t nameId) const;
+    XMLIndexRange GetNodesByAttribute(std::string_view key, std::string_view value) const;
+    void BuildIndex() const;
+    bool HasIndex() const;
+
     size_t GetNrOfNodes() const;
 
+    // Entity and character references decoded, e.g. '&amp;' and '&#x41;'. Text without a '&' comes back as the very same view,
+    // anything else is decoded into the document's memory resource on first access and cached. Safe to call from multiple threads
+    std::string_view GetContent(XMLElement const& element) const;
+    std::optional<std::string_view> GetAttributeValue(XMLElement const& element, std::string_view key) const;
+    std::optional<std::string_view> GetAttributeValue(XMLElement const& element, uint32_t keyId) const;
+
+    // Tree navigation, every step is a single index lookup in the node array
+    std::optional<std::reference_wrapper<XMLElement const>> GetRoot() const;
+    std::optional<std::reference_wrapper<XMLElement const>> GetParent(XMLElement const& element) const;
+    std::optional<std::reference_wrapper<XMLElement const>> GetFirstChild(XMLElement const& element) const;
+    std::optional<std::reference_wrapper<XMLElement const>> GetNextSibling(XMLElement const& element) const;
+    XMLSiblingRange GetChildren(XMLElement const& element) const;
+
+    // Position of 'element' in document order, 'element' must belong to this document
+    uint32_t GetIndex(XMLElement const& element) const;
+
    private:
-    void AddXMLElement(XMLElement const&& element, bool front);
+    XMLDocument(std::pmr::vector<XMLElement>&& elements, std::pmr::vector<XMLAttribute>&& attributes);
+
+    // 'names' already holds every element and attribute name and every element has its ID, e.g. when the parser interned them as it went
+    XMLDocument(std::pmr::vector<XMLElement>&& elements, std::pmr::vector<XMLAttribute>&& attributes, XMLNameTable&& names);
+
+    // Points every element's attribute view at this document's attribute array
+    void BindAttributes();
+
+    // Decoding behind GetContent and GetAttributeValue. 'raw' has to be a content or attribute value view of this document, the cache
+    // entry it gets lives as long as the document
+    std::string_view Decode(std::string_view raw) const;
+
+    // Adds the names of 'elements' and 'attributes' to 'm_names' and gives every element in 'elements' its ID
+    void InternNames(std::span<XMLElement> elements, std::span<XMLAttribute const> attributes);
   };
 }  // namespace fxml
\ No newline at end of file
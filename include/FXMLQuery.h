@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  /*
+  A path expression compiled once and evaluated against any number of documents. Supported is the subset of XPath we use:
+
+    /root/node_two/name      children, starting at the top-level elements
+    //item                   descendants at any depth, a path without a leading '/' means the same
+    *                        any name
+    item[@type]              the attribute is present
+    item[@type='x']          the attribute has this value, after decoding references
+    item[2]                  the second sibling which matches the step so far (1-based), must be the last predicate of a step
+
+  Evaluation goes bottom-up, every candidate is checked against the last step and then walks its parent links towards the first one
+  Names get resolved to the document's name IDs once per evaluation, and attribute values only get decoded when they hold a reference
+  Nothing gets allocated while evaluating queries of up to 8 steps, when the document has its name index only the elements with the last
+  step's name are checked
+  */
+  class XMLQuery
+  {
+   public:
+    enum class Axis
+    {
+      CHILD = 0,
+      DESCENDANT = 1
+    };
+
+    struct AttributeTest
+    {
+      std::string key;
+      std::optional<std::string> value;
+    };
+
+    struct Step
+    {
+      Axis axis;
+      std::string name;  // "*" matches any name
+      std::vector<AttributeTest> attributes;
+      uint32_t position = 0;  // 0 if the step has no positional predicate
+    };
+
+   private:
+    // The steps' names as IDs of the document being evaluated, INVALID_ID for "*"
+    struct NameIds
+    {
+      static constexpr size_t NR_OF_INLINE_IDS = 8;
+
+      std::array<uint32_t, NR_OF_INLINE_IDS> inlineIds{};
+      std::vector<uint32_t> heapIds;  // Only for queries with more steps than fit inline
+      std::span<uint32_t> ids;
+
+      NameIds() = default;
+      NameIds(NameIds const&) = delete;
+      NameIds& operator=(NameIds const&) = delete;
+    };
+
+    std::vector<Step> m_steps;
+
+   public:
+    static std::expected<XMLQuery, XMLError> Compile(std::string_view expression);
+
+    // Calls 'visitor' with every matching element in document order, a visitor returning bool stops the evaluation by returning false
+    template <typename Visitor>
+    void ForEach(XMLDocument const& document, Visitor&& visitor) const
+    {
+      auto const visit = [&visitor](XMLElement const& element)
+      {
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, XMLElement const&>, bool>)
+        {
+          return visitor(element);
+        }
+        else
+        {
+          visitor(element);
+          return true;
+        }
+      };
+
+      NameIds nameIds;
+      if (!ResolveNames(document, nameIds))
+      {
+        return;
+      }
+
+      uint32_t const lastNameId = nameIds.ids.back();
+      if (document.HasIndex() && lastNameId != XMLNameTable::INVALID_ID)
+      {
+        for (XMLElement const& element : document.GetNodesByName(lastNameId))
+        {
+          if (MatchesFrom(document, nameIds.ids, document.GetIndex(element), m_steps.size() - 1) && !visit(element))
+          {
+            return;
+          }
+        }
+
+        return;
+      }
+
+      for (uint32_t i{}; i < document.GetNrOfNodes(); ++i)
+      {
+        if (MatchesFrom(document, nameIds.ids, i, m_steps.size() - 1) && !visit(document.GetNodeByIndex(i).value().get()))
+        {
+          return;
+        }
+      }
+    }
+
+    std::optional<std::reference_wrapper<XMLElement const>> First(XMLDocument const& document) const;
+    size_t Count(XMLDocument const& document) const;
+
+    // Whether the element at 'index' is selected by the query
+    bool Matches(XMLDocument const& document, uint32_t index) const;
+
+    std::vector<Step> const& GetSteps() const;
+
+   private:
+    XMLQuery() = default;
+
+    // False if a step names an element the document does not have, nothing can match then
+    bool ResolveNames(XMLDocument const& document, NameIds& nameIds) const;
+
+    bool MatchesFrom(XMLDocument const& document, std::span<uint32_t const> nameIds, uint32_t index, size_t step) const;
+    bool MatchesStep(XMLDocument const& document, uint32_t nameId, uint32_t index, Step const& step) const;
+    bool MatchesNameAndAttributes(XMLDocument const& document, uint32_t nameId, uint32_t index, Step const& step) const;
+  };
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  enum class XMLNodeType
+  {
+    NONE = 0,
+    START_ELEMENT = 1,
+    END_ELEMENT = 2,
+    TEXT = 3,
+    COMMENT = 4
+  };
+
+  // Lexes the attributes of a start tag one at a time while iterating, nothing gets stored
+  class XMLLazyAttributeIterator
+  {
+   private:
+    std::string_view m_rawTag;
+    size_t m_offset = 0;
+    std::optional<XMLAttribute> m_attribute;
+
+   public:
+    using value_type = XMLAttribute;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    XMLLazyAttributeIterator() = default;
+    XMLLazyAttributeIterator(std::string_view rawTag, size_t offset);
+
+    XMLAttribute const& operator*() const;
+    XMLAttribute const* operator->() const;
+    XMLLazyAttributeIterator& operator++();
+    XMLLazyAttributeIterator operator++(int);
+    bool operator==(XMLLazyAttributeIterator const& other) const;
+  };
+
+  // The attributes of the start tag an XMLReader is on. A malformed attribute ends the iteration, unlike XMLParser nothing is validated
+  class XMLLazyAttributes
+  {
+   private:
+    std::string_view m_rawTag;
+    size_t m_offset = 0;
+
+   public:
+    XMLLazyAttributes() = default;
+    XMLLazyAttributes(std::string_view rawTag, size_t offset);
+
+    std::optional<std::string_view> find(std::string_view key) const;
+
+    XMLLazyAttributeIterator begin() const;
+    XMLLazyAttributeIterator end() const;
+  };
+
+  /*
+  Pull-based cursor over a buffer which stays owned by the caller. Next() only finds the bounds of the next node,
+  names, text and attributes are views into the buffer which get looked at when asked for
+  */
+  class XMLReader
+  {
+   private:
+    std::string_view m_buffer;
+    size_t m_bufferPointer = 0;
+
+    // The node the cursor is on
+    XMLNodeType m_type = XMLNodeType::NONE;
+    std::string_view m_name;
+    std::string_view m_text;
+    std::string_view m_rawTag;
+    bool m_isEmptyElement = false;
+
+    // Only grows with the nesting depth, not with the number of nodes
+    std::vector<std::string_view> m_openNames;
+
+   public:
+    explicit XMLReader(std::string_view xml);
+
+    // Moves to the next node, returns false once the whole buffer has been read
+    std::expected<bool, XMLError> Next();
+
+    // Moves from a start tag to its matching end tag, everything in between is only scanned for tag boundaries
+    std::expected<void, XMLError> SkipSubtree();
+
+    XMLNodeType Type() const;
+
+    // Start or end tag
+    std::string_view Name() const;
+
+    // Start tag
+    XMLLazyAttributes Attributes() const;
+
+    // Content or comment
+    std::string_view Text() const;
+
+    bool IsEmptyElement() const;
+
+    // Number of elements enclosing the current node
+    size_t Depth() const;
+
+   private:
+    // ==============================
+    // ====== TOKENIZER EVENTS ======
+    // ==============================
+    template <typename Handler>
+    friend class Tokenizer;
+
+    bool HasOpenElement() const;
+    std::expected<void, XMLError> OnRawStartTag(std::string_view name, std::string_view rawTag, bool isEmptyElement);
+    std::expected<void, XMLError> OnEndTag(std::string_view name);
+    std::expected<void, XMLError> OnContent(std::string_view content);
+    std::expected<void, XMLError> OnComment(std::string_view comment);
+  };
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <expected>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  // Receives the events of an XMLSaxParser. Every view handed to a callback is only valid for the duration of that callback
+  class XMLSaxHandler
+  {
+   public:
+    virtual ~XMLSaxHandler() = default;
+
+    // Returning an error stops the parse, XMLSaxParser then returns that same error
+    virtual std::expected<void, XMLError> OnStartElement(std::string_view name, XMLAttributes attributes);
+    virtual std::expected<void, XMLError> OnEndElement(std::string_view name);
+    virtual std::expected<void, XMLError> OnText(std::string_view text);
+    virtual std::expected<void, XMLError> OnComment(std::string_view comment);
+  };
+
+  /*
+  Push-based parser which builds no document, events go straight to an XMLSaxHandler
+  Files are read in fixed-size chunks, so memory use depends on the nesting depth and the largest single token, not on the file size
+  */
+  class XMLSaxParser
+  {
+   public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    // Fills the span with the next bytes of the input and returns how many were written, 0 means the input is exhausted
+    using ChunkReader = std::function<std::expected<size_t, XMLError>(std::span<char> chunk)>;
+
+   private:
+    size_t m_chunkSize;
+    std::vector<char> m_chunk;
+
+    // Scratch storage for the attributes of the current start tag
+    std::vector<XMLAttribute> m_attributes;
+
+    // Names of every open element back to back, views into the chunk do not survive the next read
+    std::string m_openNames;
+    std::vector<size_t> m_openNameOffsets;
+
+    XMLSaxHandler* m_handler = nullptr;
+
+   public:
+    explicit XMLSaxParser(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    std::expected<void, XMLError> Parse(std::string_view filepath, XMLSaxHandler& handler);
+    std::expected<void, XMLError> ParseFromMemory(std::string_view xml, XMLSaxHandler& handler);
+
+    // Drives the parse from any byte source, e.g. a socket or a decompressor
+    std::expected<void, XMLError> ParseChunks(ChunkReader const& reader, XMLSaxHandler& handler);
+
+    // Reads a gzip or zstd file through an XMLCompressedReader, decompressing on a second thread a few blocks ahead of the tokenizer
+    std::expected<void, XMLError> ParseCompressed(std::string_view filepath, XMLSaxHandler& handler);
+
+   private:
+    void Reset(XMLSaxHandler& handler);
+    std::expected<void, XMLError> CheckAllElementsClosed() const;
+
+    // ==============================
+    // ====== TOKENIZER EVENTS ======
+    // ==============================
+    template <typename Handler>
+    friend class Tokenizer;
+
+    std::vector<XMLAttribute>& GetAttributeStorage();
+    bool HasOpenElement() const;
+    std::expected<void, XMLError> OnStartTag(std::string_view name, std::span<XMLAttribute const> attributes, bool isEmptyElement);
+    std::expected<void, XMLError> OnEndTag(std::string_view name);
+    std::expected<void, XMLError> OnContent(std::string_view content);
+    std::expected<void, XMLError> OnComment(std::string_view comment);
+  };
+}  // namespace fxml
\ No newline at end of file
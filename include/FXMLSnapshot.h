@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <memory_resource>
+#include <string_view>
+
+#include "FXML.h"
+#include "FXMLData.h"
+
+namespace fxml
+{
+  /*
+  Pre-parsed documents on disk, so a large file that rarely changes does not get parsed on every start-up
+  A snapshot holds the node table, the attribute table and the text every view points into, all as offsets. Loading one maps the file
+  and turns the tables back into a document in a single pass, nothing gets tokenized
+
+  Snapshots are tied to their source by its size and checksum, and to the machine by the version and byte order of the format
+  */
+  class XMLSnapshot
+  {
+   public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Checksum of a source text, as stored in its snapshot
+    static uint64_t Checksum(std::string_view text);
+
+    // 'document' must own its text, use the second overload if it points into caller-owned 'text'. Filtered documents cannot be written
+    static std::expected<void, XMLError> Write(XMLDocument const& document, std::string_view snapshotPath);
+    static std::expected<void, XMLError> Write(XMLDocument const& document, std::string_view text, std::string_view snapshotPath);
+
+    // Fails with ErrorReason::INVALID_SNAPSHOT if the file is no valid snapshot of a source with 'sourceSize' and 'sourceChecksum'
+    // The document points into the mapped snapshot, its node arrays live in 'memoryResource' (nullptr is the default resource)
+    static std::expected<XMLDocument, XMLError> Load(std::string_view snapshotPath, size_t sourceSize, uint64_t sourceChecksum,
+                                                     std::pmr::memory_resource* memoryResource = nullptr);
+
+    // Loads the snapshot when it still matches 'sourcePath', otherwise parses the source and writes a new snapshot for the next time
+    // Parses with a ParseOptions::filter always parse the source, snapshots only ever hold whole documents
+    static std::expected<XMLDocument, XMLError> LoadOrParse(std::string_view sourcePath, std::string_view snapshotPath, ParseOptions const& options = {});
+  };
+}  // namespace fxml
\ No newline at end of file
@@ -1,406 +1,402 @@
 #include "FXML.h"
 
-#include <array>
-#include <filesystem>
+#include <algorithm>
 #include <format>
 #include <fstream>
-#include <functional>
-#include <limits>
-#include <ranges>
+#include <string>
+#include <thread>
 
 #include "FXMLData.h"
-
-#if defined(__GNUC__) || defined(__GNUG__)
-#define FORCE_INLINE __attribute__((always_inline)) inline
-#elif defined(_MSC_VER)
-#define FORCE_INLINE __forceinline
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 namespace fxml
 {
-  namespace
+  namespace detail
   {
-#define CHECK_EXPECTED_VOID(expected)    \
-  if (auto const res = (expected); !res) \
-  {                                      \
-    return std::unexpected{res.error()}; \
-  }
-#define CHECK_EXPECTED(type, name, expected, errorMsg)       \
-  type name;                                                 \
-  if (auto const res = (expected); !res)                     \
-  {                                                          \
-    return std::unexpected{XMLError{res.error(), errorMsg}}; \
-  }                                                          \
-  else                                                       \
-  {                                                          \
-    name = res.value();                                      \
-  }
-#define CHECK_EXPECTED_NO_TRANSFORM(type, name, expected) \
-  type name;                                              \
-  if (auto const res = (expected); !res)                  \
-  {                                                       \
-    return std::unexpected{res.error()};                  \
-  }                                                       \
-  else                                                    \
-  {                                                       \
-    name = res.value();                                   \
-  }
-#define RETURN_OK() \
-  return std::expected<void, XMLError> {}
-
-    struct OnExitScope
+    std::expected<void*, XMLError> MapFile(std::string_view filepath, size_t size, MemoryMap const& options)
     {
-      std::function<void()> onExit;
-
-      ~OnExitScope()
+#ifdef _WIN32
+      HANDLE const file =
+          CreateFileA(std::string(filepath).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                      options.sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
       {
-        onExit();
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
       }
-    };
-
-    std::expected<size_t, XMLError> GetFileSize(std::string_view filepath)
-    {
-      std::error_code ec;
-      size_t const size = std::filesystem::file_size(filepath, ec);
+      OnExitScope closeFile{[file]() { CloseHandle(file); }};
 
-      if (ec)
+      HANDLE const mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping)
       {
-        return std::unexpected{XMLError{ErrorReason::CANNOT_FIND_FILE, std::format("Cannot get file size of {}", filepath)}};
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not memory-map '{}'", filepath)}};
       }
+      OnExitScope closeMapping{[mapping]() { CloseHandle(mapping); }};
 
-      return size;
-    }
-
-    std::pair<size_t, char> FindFirstChar(std::string_view const buffer, std::initializer_list<char> chars, size_t offset = 0, bool reverse = false)
-    {
-      size_t min = std::string_view::npos;
-      char foundChar = '\0';
+      // The view keeps the mapping alive, so both handles can be closed once it exists
+      void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+      if (!view)
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not memory-map '{}'", filepath)}};
+      }
 
-      for (char c : chars)
+      if (options.populate)
       {
-        size_t const pos = reverse ? buffer.rfind(c, offset) : buffer.find(c, offset);
-        if (pos < min)
-        {
-          foundChar = c;
-          min = pos;
-        }
+        WIN32_MEMORY_RANGE_ENTRY range{view, size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
       }
 
-      return {min, foundChar};
-    }
+      return view;
+#else
+      int const fd = open(std::string(filepath).c_str(), O_RDONLY);
+      if (fd == -1)
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
+      }
+      OnExitScope closeFile{[fd]() { close(fd); }};
 
-    // std::string_view TrimWhitespace(std::string_view str)
-    // {
-    //   size_t const strBegin{str.find_first_not_of(" \t")};
-    //   if (strBegin == std::string_view::npos)
-    //   {
-    //     return "";
-    //   }
+      int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+      if (options.populate)
+      {
+        flags |= MAP_POPULATE;
+      }
+#endif
 
-    //   size_t const strEnd{str.find_last_not_of(" \t")};
-    //   return str.substr(strBegin, strEnd - strBegin + 1);
-    // }
+      // The mapping keeps the file alive, so the descriptor can be closed once it exists
+      void* const view = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+      if (view == MAP_FAILED)
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not memory-map '{}'", filepath)}};
+      }
 
-    FORCE_INLINE std::expected<char, ErrorReason> SafeAccess(std::string_view str, size_t index)
-    {
-      if (index >= str.size()) return std::unexpected{ErrorReason::PARSE_ERROR};
-      return str[index];
-    }
+      if (options.sequential)
+      {
+        madvise(view, size, MADV_SEQUENTIAL);
+      }
 
-    FORCE_INLINE std::expected<size_t, ErrorReason> SafeFind(std::string_view str, char c, size_t offset = 0)
-    {
-      size_t const pos = str.find(c, offset);
-      if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
-      return pos;
+      return view;
+#endif
     }
 
-    FORCE_INLINE std::expected<size_t, ErrorReason> SafeFind(std::string_view str, std::string_view toFind, size_t offset = 0)
+    void UnmapFile(void* view, [[maybe_unused]] size_t size)
     {
-      size_t const pos = str.find(toFind, offset);
-      if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
-      return pos;
+#ifdef _WIN32
+      UnmapViewOfFile(view);
+#else
+      munmap(view, size);
+#endif
     }
+  }  // namespace detail
 
-    // FORCE_INLINE std::expected<size_t, ErrorReason> SafeFindList(std::string_view str, std::initializer_list<std::string_view> list, size_t offset = 0)
-    // {
-    //   size_t pos = std::string_view::npos;
-    //   for (std::string_view toFind : list)
-    //   {
-    //     size_t const found = str.find(toFind, offset);
-    //     pos = std::min(found, pos);
-    //   }
-    //   if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
-    //   return pos;
-    // }
-
-    FORCE_INLINE std::expected<std::string_view, ErrorReason> SafeGet(std::string_view str, size_t nr, size_t offset = 0)
-    {
-      if (nr >= str.size()) return std::unexpected{ErrorReason::PARSE_ERROR};
-      return str.substr(offset, nr);
-    }
+  using namespace detail;
 
-    bool IsFullyWhiteSpace(std::string_view str)
-    {
-      for (char const c : str)
-      {
-        if (!std::isspace(c))
-        {
-          return false;
-        }
-      }
+  XMLParser::XMLParser()
+    : XMLParser(ParseOptions{})
+  {
+  }
 
-      return true;
-    }
-  }  // namespace
+  XMLParser::XMLParser(ParseOptions const& options)
+    : m_options(options)
+    , m_elements(options.memoryResource ? options.memoryResource : std::pmr::get_default_resource())
+    , m_attributes(m_elements.get_allocator())
+    , m_names(m_elements.get_allocator().resource())
+  {
+    m_options.memoryResource = m_elements.get_allocator().resource();
+  }
 
-  XMLParser::~XMLParser()
+  void XMLParser::Reset()
   {
-    if (m_buffer)
-    {
-      delete[] m_buffer;
-      m_buffer = nullptr;
-    }
+    m_bufferPointer = 0;
+    m_elementStack.clear();
+    m_lastTopLevelElement = XMLElement::INVALID_INDEX;
+    m_elements.clear();
+    m_attributes.clear();
+    m_names.clear();
+    m_lastKeyIds.clear();
+    m_skippedElementStack.clear();
   }
 
   std::expected<XMLDocument, XMLError> XMLParser::Parse(std::string_view filepath)
   {
-    return GetFileSize(filepath).and_then(
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    auto result = GetFileSize(filepath).and_then(
         [this, filepath](size_t size)
         {
-          m_bufferSize = size;
-          m_buffer = new char[m_bufferSize]{};
-          return ParseImpl(filepath);
+          std::pmr::memory_resource* const resource = m_options.memoryResource;
+          XMLSource source{static_cast<char const*>(resource->allocate(size, 1)), size,
+                           [resource](char const* data, size_t dataSize) { resource->deallocate(const_cast<char*>(data), dataSize, 1); }};
+          FXML_INSTRUMENT(m_stats.bytesAllocated += size);
+
+          return ParseImpl(filepath, std::span<char>{const_cast<char*>(source.GetText().data()), size})
+              .transform([this, &source](XMLDocument&& doc) { return AttachSource(std::move(doc), std::move(source)); });
         });
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
   }
   std::expected<XMLDocument, XMLError> XMLParser::Parse(std::string_view filepath, Buffer const& buffer)
   {
-    return GetFileSize(filepath)
-        .and_then(
-            [&buffer](size_t size) -> std::expected<void, XMLError>
-            {
-              if (buffer.bufferSize < size)
-              {
-                return std::unexpected{XMLError{ErrorReason::BUFFER_TOO_SMALL, "Provided buffer is too small for filesize"}};
-              }
-
-              return {};
-            })
-        .and_then(
-            [this, &buffer, filepath]()
-            {
-              m_bufferSize = buffer.bufferSize;
-              m_buffer = buffer.buffer;
-              return ParseImpl(filepath);
-            });
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    // Owned from here on, so the buffer also gets released when the parse fails
+    XMLSource source;
+    if (buffer.release)
+    {
+      source = XMLSource{buffer.buffer, buffer.bufferSize,
+                         [release = buffer.release](char const* data, size_t size) { release(const_cast<char*>(data), size); }};
+    }
+
+    auto result = GetFileSize(filepath)
+                      .and_then(
+                          [&buffer](size_t size) -> std::expected<void, XMLError>
+                          {
+                            if (buffer.bufferSize < size)
+                            {
+                              return std::unexpected{XMLError{ErrorReason::BUFFER_TOO_SMALL, "Provided buffer is too small for filesize"}};
+                            }
+
+                            return {};
+                          })
+                      .and_then([this, &buffer, filepath]() { return ParseImpl(filepath, std::span<char>{buffer.buffer, buffer.bufferSize}); })
+                      .transform([this, &source](XMLDocument&& doc) { return AttachSource(std::move(doc), std::move(source)); });
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
+  }
+  std::expected<XMLDocument, XMLError> XMLParser::Parse(std::string_view filepath, MemoryMap const& options)
+  {
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    auto result = GetFileSize(filepath).and_then(
+        [this, filepath, &options](size_t size) -> std::expected<XMLDocument, XMLError>
+        {
+          // Mapping an empty file is an error on every platform, there is nothing to point into anyway
+          if (size == 0)
+          {
+            return ParseBuffer({});
+          }
+
+          FXML_INSTRUMENT(ScopedTimer loadTimer{m_stats.loadTime});
+          CHECK_EXPECTED_NO_TRANSFORM(void*, view, MapFile(filepath, size, options));
+          XMLSource source{static_cast<char const*>(view), size, [](char const* data, size_t dataSize) { UnmapFile(const_cast<char*>(data), dataSize); }};
+          FXML_INSTRUMENT(loadTimer.Stop());
+
+          return ParseBuffer(source.GetText()).transform([this, &source](XMLDocument&& doc) { return AttachSource(std::move(doc), std::move(source)); });
+        });
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
   }
 
-  std::expected<XMLDocument, XMLError> XMLParser::ParseImpl(std::string_view filepath)
+  std::expected<XMLDocument, XMLError> XMLParser::ParseFromMemory(std::string_view xml)
   {
-    {
-      std::ifstream file{std::string(filepath)};
-      if (!file.is_open())
-      {
-        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
-      }
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
 
-      file.read(m_buffer, m_bufferSize);
-    }
+    auto result = ParseBuffer(xml);
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
+  }
+
+#if FXML_ENABLE_INSTRUMENTATION
+  XMLParseStats const& XMLParser::GetStats() const
+  {
+    return m_stats;
+  }
 
-    XMLDocument doc;
-    if (auto const ret = ParseDocument(m_buffer, m_bufferSize, m_bufferPointer); !ret.has_value())
+  void XMLParser::CollectStats(std::pmr::vector<XMLElement> const& elements, std::pmr::vector<XMLAttribute> const& attributes)
+  {
+    m_stats.nrOfElements = elements.size();
+    m_stats.nrOfAttributes = attributes.size();
+    m_stats.bytesAllocated += elements.capacity() * sizeof(XMLElement) + attributes.capacity() * sizeof(XMLAttribute);
+
+    // Parents come before their children, so every depth is known by the time it is needed
+    std::vector<uint32_t> depths(elements.size());
+    for (size_t i{}; i < elements.size(); ++i)
     {
-      return std::unexpected{ret.error()};
+      uint32_t const parent = elements[i].m_parent;
+      depths[i] = parent == XMLElement::INVALID_INDEX ? 1 : depths[parent] + 1;
+      m_stats.maxDepth = std::max<size_t>(m_stats.maxDepth, depths[i]);
     }
+  }
 
-    for (size_t i{}; i < m_elements.size(); ++i)
+  void XMLParser::ReportStats() const
+  {
+    if (m_options.onStats)
     {
-      doc.AddXMLElement(std::move(m_elements[i]), false);
+      m_options.onStats(m_stats);
     }
+  }
+#endif
 
-    return doc;
+  XMLDocument XMLParser::AttachSource(XMLDocument&& doc, XMLSource&& source)
+  {
+    FXML_INSTRUMENT(ScopedTimer const handOffTimer{m_stats.handOffTime});
+    doc.m_source = std::move(source);
+    return std::move(doc);
   }
 
-  std::expected<void, XMLError> XMLParser::ParseDocument(std::string_view const buffer, size_t bufferSize, size_t& bufferPointer)
+  std::expected<XMLDocument, XMLError> XMLParser::ParseImpl(std::string_view filepath, std::span<char> buffer)
   {
-    while (bufferPointer < bufferSize)
+    size_t bytesRead{};
     {
-      while (std::isspace(buffer[bufferPointer]) && bufferPointer < bufferSize)
-      {
-        ++bufferPointer;
-      }
-
-      CHECK_EXPECTED(std::string_view, start, SafeGet(buffer, 2, bufferPointer), "EOF reached while parsing, file seems incomplete");
-      if (start == "<!")
-      {
-        CHECK_EXPECTED_VOID(ParseComment(buffer, bufferPointer));
-      }
-      else if (start == "</")
-      {
-        if (m_elementStack.empty())
-        {
-          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag reached while no start tag was parsed"}};
-        }
-
-        CHECK_EXPECTED_VOID(ParseEndTag(buffer, bufferPointer));
-      }
-      else if (start[0] == '<')
+      FXML_INSTRUMENT(ScopedTimer const loadTimer{m_stats.loadTime});
+      std::ifstream file{std::string(filepath), std::ios::binary};
+      if (!file.is_open())
       {
-        CHECK_EXPECTED_VOID(ParseStartTag(buffer, bufferPointer));
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
       }
-      else
-      {
-        if (IsFullyWhiteSpace(start))
-        {
-          bufferPointer += start.size();
-          continue;
-        }
 
-        if (m_elementStack.empty())
-        {
-          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Trying to parse content when no start tag was parsed"}};
-        }
-
-        CHECK_EXPECTED_VOID(ParseContent(buffer, bufferPointer));
-      }
+      file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      bytesRead = static_cast<size_t>(file.gcount());
     }
 
-    RETURN_OK();
+    // A user-provided buffer may be larger than the file, whatever is behind the file contents is not part of the document
+    return ParseBuffer(std::string_view{buffer.data(), bytesRead});
   }
 
-  std::expected<void, XMLError> XMLParser::ParseStartTag(std::string_view const buffer, size_t& bufferPointer)
+  std::expected<XMLDocument, XMLError> XMLParser::ParseBuffer(std::string_view buffer)
   {
-    // Tags must start with <
-    if (SafeAccess(buffer, bufferPointer) != '<')
+    if (!m_options.filter.empty())
     {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Expected <"}};
+      return ParseBufferFiltered(buffer);
     }
 
-    // Our 'rawTag' will look like <NAME [Attributes]
-    CHECK_EXPECTED(size_t, pos, SafeFind(buffer, '>', bufferPointer + 1), "Could not find closing bracket of start tag");
-    std::string_view const rawTag = buffer.substr(bufferPointer, pos - bufferPointer + 1);  // + 1 to capture closing bracket as well
-
-    // Check for attributes ('=') or closing bracket
-    std::pair<size_t, char> p = FindFirstChar(rawTag, {'=', '>'});
-    if (p.first == std::string_view::npos)
+    size_t const threadCount = m_options.threadCount > 0 ? m_options.threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    if (size_t const nrOfChunks = std::min(threadCount, buffer.size() / std::max(m_options.minChunkSize, size_t{1})); nrOfChunks > 1)
     {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Start tag is not properly closed"}};
+      return ParseBufferParallel(buffer, nrOfChunks);
     }
 
-    CHECK_EXPECTED(char, c, SafeAccess(buffer, 1), "Start tag is malformed");
-    if (std::isspace(c))
-    {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Start tag is malformed"}};
-    }
+    Reset();
 
-    XMLTag tag;
-    tag.name = rawTag.substr(1, FindFirstChar(rawTag, {'=', '>', ' ', '\t'}).first - 1);
-
-    size_t attrOffset{};
-    while (true)
     {
-      size_t attrPos = rawTag.find('=', attrOffset);
-      if (attrPos == std::string_view::npos)
-      {
-        break;
-      }
-
-      // find left hand part of attribute
-      auto [leftHandPosStart, _c] = FindFirstChar(rawTag, {' ', '\t'}, attrPos, true);
-      auto [leftHandPosEnd, _c2] = FindFirstChar(rawTag, {' ', '\t', '='}, leftHandPosStart + 1);
-      if (leftHandPosStart == std::string_view::npos || leftHandPosEnd == std::string_view::npos)
-      {
-        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Attribute in tag '{}' is malformed", tag.name)}};
-      }
-
-      // Find right hand part of attribute
-      auto [rightHandPosStart, _c3] = FindFirstChar(rawTag, {'"'}, attrPos);
-      auto [rightHandPosEnd, _c4] = FindFirstChar(rawTag, {'"'}, rightHandPosStart + 1);
-      if (rightHandPosEnd == std::string_view::npos || rightHandPosEnd == std::string_view::npos)
+      FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+      if (auto const ret = Tokenizer{*this}.ParseDocument(buffer, m_bufferPointer); !ret.has_value())
       {
-        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Attribute in tag '{}' is malformed", tag.name)}};
-      }
-
-      // 'leftHandPos' starts at the character right before the key, so we must do + 1 to get the actual start of they key
-      // We have to do - 1 in the length to subtract the '=' part of the attribute
-      std::string_view const key = rawTag.substr(leftHandPosStart + 1, leftHandPosEnd - leftHandPosStart - 1);
-      if (tag.attributes.contains(key))
-      {
-        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Attribute key '{}' already present in tag '{}'", key, tag.name)}};
+        return std::unexpected{ret.error()};
       }
+    }
+    FXML_INSTRUMENT(m_stats.bytesScanned = m_bufferPointer);
 
-      // At the end, we do - 1 because 'rightHandPosEnd' takes the terminating '"' into account
-      std::string_view const value = rawTag.substr(rightHandPosStart + 1, rightHandPosEnd - rightHandPosStart - 1);
-      tag.attributes.emplace(key, value);
+    return BuildDocument();
+  }
 
-      attrOffset = attrPos + 1;
+  std::expected<XMLDocument, XMLError> XMLParser::BuildDocument()
+  {
+    if (!m_elementStack.empty())
+    {
+      return std::unexpected{XMLError{
+          ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", m_elements[m_elementStack.back().index].GetTag().name)}};
     }
 
-    // Always add the start tag in-order in our list of elements
-    m_elements.push_back(XMLElement{std::move(tag)});
+    FXML_INSTRUMENT(CollectStats(m_elements, m_attributes));
+    FXML_INSTRUMENT(ScopedTimer const buildTimer{m_stats.buildTime});
 
-    // If not an empty-element tag, put it in our stack so it can be used later for endtag/content matching
-    if (SafeGet(rawTag, 2, rawTag.size() - 2) != "/>")
+    // Hand the flat arrays over as a whole, no per-element moves or allocations
+    XMLDocument doc{std::move(m_elements), std::move(m_attributes), std::move(m_names)};
+    if (m_options.buildIndex)
     {
-      m_elementStack.emplace(XMLElement{std::move(tag)});
+      doc.BuildIndex();
     }
 
-    bufferPointer += rawTag.size();
+    return doc;
+  }
 
-    RETURN_OK();
+  std::pmr::vector<XMLAttribute>& XMLParser::GetAttributeStorage()
+  {
+    return m_attributes;
   }
 
-  std::expected<void, XMLError> XMLParser::ParseEndTag(std::string_view buffer, size_t& bufferPointer)
+  bool XMLParser::HasOpenElement() const
   {
-    if (SafeAccess(buffer, bufferPointer) != '<')
+    return !m_elementStack.empty();
+  }
+
+  std::expected<void, XMLError> XMLParser::OnStartTag(std::string_view name, std::span<XMLAttribute const> attributes, bool isEmptyElement)
+  {
+    // Always add the start tag in-order in our list of elements, linked to its parent and previous sibling
+    // The tokenizer appended the attributes straight to 'm_attributes', so they are the last ones in there
+    uint32_t const index = static_cast<uint32_t>(m_elements.size());
+    XMLElement element{name, static_cast<uint32_t>(m_attributes.size() - attributes.size()), static_cast<uint32_t>(attributes.size())};
+    uint32_t& previousSibling = m_elementStack.empty() ? m_lastTopLevelElement : m_elementStack.back().lastChild;
+    if (!m_elementStack.empty())
+    {
+      element.m_parent = m_elementStack.back().index;
+      if (previousSibling == XMLElement::INVALID_INDEX)
+      {
+        m_elements[element.m_parent].m_firstChild = index;
+      }
+    }
+    if (previousSibling != XMLElement::INVALID_INDEX)
     {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag must start with '</'"}};
+      m_elements[previousSibling].m_nextSibling = index;
     }
 
-    // Our 'rawTag' will look like </NAME
-    CHECK_EXPECTED(size_t, pos, SafeFind(buffer, '>', bufferPointer + 1), "End tag closing bracket could not be found");
-    std::string_view const rawTag = buffer.substr(bufferPointer, pos - bufferPointer);
-
-    if (SafeAccess(buffer, bufferPointer + 1) != '/')
+    // Runs of same-named siblings and of tags repeating their keys are the common case, a compare against the previous name saves a hash lookup
+    element.m_nameId = previousSibling != XMLElement::INVALID_INDEX && m_elements[previousSibling].GetTag().name == name
+                           ? m_elements[previousSibling].m_nameId
+                           : m_names.Intern(name);
+    if (m_lastKeyIds.size() < attributes.size())
     {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag must start with '</'"}};
+      m_lastKeyIds.resize(attributes.size(), XMLNameTable::INVALID_ID);
     }
+    for (size_t i{}; i < attributes.size(); ++i)
+    {
+      if (m_names.GetName(m_lastKeyIds[i]) != attributes[i].key)
+      {
+        m_lastKeyIds[i] = m_names.Intern(attributes[i].key);
+      }
+    }
+    previousSibling = index;
 
-    bufferPointer += rawTag.size() + 1;  // + 1 because 'rawTag' does not have the closing bracket
+    m_elements.push_back(element);
 
-    if (m_elementStack.top().GetTag().name != rawTag.substr(2))
+    // If not an empty-element tag, put it in our stack so it can be used later for endtag/content matching
+    if (!isEmptyElement)
     {
-      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", rawTag.substr(2))}};
+      m_elementStack.push_back(OpenElement{index, XMLElement::INVALID_INDEX});
     }
 
-    *(std::ranges::find_if(m_elements, [rawTag](XMLElement const& element) { return element.GetTag().name == rawTag.substr(2); })) = m_elementStack.top();
-    m_elementStack.pop();
-
     RETURN_OK();
   }
 
-  std::expected<void, XMLError> XMLParser::ParseContent(std::string_view buffer, size_t& bufferPointer)
+  std::expected<void, XMLError> XMLParser::OnEndTag(std::string_view name)
   {
-    // Search until the next node
-    CHECK_EXPECTED(size_t, pos, SafeFind(buffer, '<', bufferPointer + 1), "No end tag found for content");
-
-    std::string_view const content = buffer.substr(bufferPointer, pos - bufferPointer);
-    m_elementStack.top().SetRawContent(content);
+    // The stack holds the index of the element this tag closes, no need to search for it
+    if (m_elements[m_elementStack.back().index].GetTag().name != name)
+    {
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+    }
 
-    bufferPointer += content.size();
+    m_elementStack.pop_back();
 
     RETURN_OK();
   }
 
-  std::expected<void, XMLError> XMLParser::ParseComment(std::string_view buffer, size_t& bufferPointer)
+  std::expected<void, XMLError> XMLParser::OnContent(std::string_view content)
   {
-    // Search until the end of the comment
-    CHECK_EXPECTED(size_t, end, SafeFind(buffer, "-->", bufferPointer + 1), "Comment is not closed");
+    FXML_INSTRUMENT(++m_stats.nrOfTextNodes);
+    m_elements[m_elementStack.back().index].SetRawContent(content);
 
-    // + 3 for '-->'
-    std::string_view const comment = buffer.substr(bufferPointer, end - bufferPointer + 3);
-
-    bufferPointer += comment.size();
+    RETURN_OK();
+  }
 
+  std::expected<void, XMLError> XMLParser::OnComment(std::string_view)
+  {
+    FXML_INSTRUMENT(++m_stats.nrOfComments);
     RETURN_OK();
   }
 }  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "FXMLArena.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace fxml
+{
+  XMLArena::XMLArena(size_t blockSize, std::pmr::memory_resource* upstream)
+    : m_upstream(upstream)
+    , m_blockSize(std::max(blockSize, size_t{64}))
+  {
+  }
+
+  XMLArena::~XMLArena()
+  {
+    Release();
+  }
+
+  void XMLArena::Reset()
+  {
+    std::lock_guard const lock{m_mutex};
+
+    if (m_blocks.size() > 1)
+    {
+      size_t const capacity = SumBlockSizes();
+      Release();
+      m_blocks.push_back(Block{static_cast<std::byte*>(m_upstream->allocate(capacity, alignof(std::max_align_t))), capacity});
+    }
+
+    m_currentBlock = 0;
+    m_offset = 0;
+    m_bytesUsed = 0;
+  }
+
+  size_t XMLArena::GetCapacity() const
+  {
+    std::lock_guard const lock{m_mutex};
+    return SumBlockSizes();
+  }
+
+  size_t XMLArena::GetBytesUsed() const
+  {
+    std::lock_guard const lock{m_mutex};
+    return m_bytesUsed;
+  }
+
+  void* XMLArena::do_allocate(size_t bytes, size_t alignment)
+  {
+    std::lock_guard const lock{m_mutex};
+    return Allocate(bytes, alignment);
+  }
+
+  void XMLArena::do_deallocate(void*, size_t, size_t)
+  {
+  }
+
+  bool XMLArena::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+  {
+    return this == &other;
+  }
+
+  size_t XMLArena::SumBlockSizes() const
+  {
+    size_t capacity{};
+    for (Block const& block : m_blocks)
+    {
+      capacity += block.size;
+    }
+
+    return capacity;
+  }
+
+  void* XMLArena::Allocate(size_t bytes, size_t alignment)
+  {
+    // Blocks which are too small for this allocation are skipped, they are only used again after a Reset()
+    for (; m_currentBlock < m_blocks.size(); ++m_currentBlock, m_offset = 0)
+    {
+      Block const& block = m_blocks[m_currentBlock];
+
+      void* p = block.data + m_offset;
+      size_t space = block.size - m_offset;
+      if (std::align(alignment, bytes, p, space))
+      {
+        m_offset = block.size - space + bytes;
+        m_bytesUsed += bytes;
+        return p;
+      }
+    }
+
+    // Every new block is at least as large as all previous ones together, so a growing vector does not go upstream on every growth
+    size_t const blockSize = std::max({m_blockSize, SumBlockSizes(), bytes + alignment});
+    m_blocks.push_back(Block{static_cast<std::byte*>(m_upstream->allocate(blockSize, alignof(std::max_align_t))), blockSize});
+    m_currentBlock = m_blocks.size() - 1;
+    m_offset = 0;
+
+    return Allocate(bytes, alignment);
+  }
+
+  void XMLArena::Release()
+  {
+    for (Block const& block : m_blocks)
+    {
+      m_upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+    }
+
+    m_blocks.clear();
+  }
+}  // namespace fxml
\ No newline at end of file
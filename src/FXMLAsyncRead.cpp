@@ -0,0 +1,358 @@
+#include "FXML.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FXMLData.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+// Set by CMake when it found liburing, every other build reads on a plain thread
+#ifndef FXML_HAS_IO_URING
+#define FXML_HAS_IO_URING 0
+#endif
+
+#if FXML_HAS_IO_URING
+#include <fcntl.h>
+#include <liburing.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace fxml
+{
+  namespace
+  {
+    // Reads start on page boundaries of a page-aligned buffer, the granularity the kernel reads and caches a file in anyway
+    constexpr size_t PAGE_SIZE = 4096;
+
+    // Loads a file into a buffer of its size on a background thread, the front of the buffer that is in grows one chunk at a time
+    class FileLoader
+    {
+     public:
+      struct Progress
+      {
+        size_t loaded;  // Bytes at the front of the buffer which are in
+        bool finished;  // Nothing more is coming, the file ends at 'loaded'
+      };
+
+     private:
+      std::span<char> m_buffer;
+      size_t m_chunkSize;
+      uint32_t m_queueDepth;
+
+      std::mutex m_mutex;
+      std::condition_variable m_progressMade;
+      Progress m_progress{};
+      std::optional<XMLError> m_error;
+
+      // Last, it has to be gone before anything it uses. Destroying it stops the loading and waits until nothing writes to the buffer
+      std::jthread m_thread;
+
+     public:
+      FileLoader(std::span<char> buffer, AsyncRead const& options)
+        : m_buffer(buffer)
+        , m_chunkSize(std::max((options.chunkSize + PAGE_SIZE - 1) / PAGE_SIZE, size_t{1}) * PAGE_SIZE)
+        , m_queueDepth(std::max(options.queueDepth, 1u))
+      {
+      }
+
+      std::expected<void, XMLError> Start(std::string_view filepath)
+      {
+        // Opened here rather than on the thread, so a file which cannot be opened fails the parse straight away
+        std::ifstream file{std::string(filepath), std::ios::binary};
+        if (!file.is_open())
+        {
+          return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
+        }
+
+        m_thread = std::jthread{[this, file = std::move(file), path = std::string(filepath)](std::stop_token stop) mutable
+                                { Load(stop, std::move(file), path); }};
+
+        RETURN_OK();
+      }
+
+      // Waits until more than 'loaded' bytes are in or the loading is over
+      std::expected<Progress, XMLError> WaitForMoreThan(size_t loaded)
+      {
+        std::unique_lock lock{m_mutex};
+        m_progressMade.wait(lock, [this, loaded]() { return m_progress.loaded > loaded || m_progress.finished; });
+        if (m_error.has_value())
+        {
+          return std::unexpected{*m_error};
+        }
+
+        return m_progress;
+      }
+
+     private:
+      void Publish(size_t loaded, bool finished, std::optional<XMLError> error = std::nullopt)
+      {
+        {
+          std::lock_guard const lock{m_mutex};
+          m_progress = Progress{loaded, finished || error.has_value()};
+          m_error = std::move(error);
+        }
+        m_progressMade.notify_one();
+      }
+
+      void Load(std::stop_token stop, std::ifstream file, std::string const& filepath)
+      {
+#if FXML_HAS_IO_URING
+        if (LoadWithUring(stop, filepath))
+        {
+          return;
+        }
+#endif
+
+        size_t offset{};
+        while (!stop.stop_requested())
+        {
+          size_t const size = std::min(m_chunkSize, m_buffer.size() - offset);
+          file.read(m_buffer.data() + offset, static_cast<std::streamsize>(size));
+          if (file.bad())
+          {
+            Publish(offset, true, XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Reading from '{}' failed", filepath)});
+            return;
+          }
+
+          // A file which shrank since its size was taken ends early, what is there is all there is
+          size_t const bytesRead = static_cast<size_t>(file.gcount());
+          offset += bytesRead;
+          bool const finished = offset == m_buffer.size() || bytesRead < size;
+          Publish(offset, finished);
+          if (finished)
+          {
+            return;
+          }
+        }
+      }
+
+#if FXML_HAS_IO_URING
+      // Keeps 'm_queueDepth' reads in flight and publishes the front of the buffer as soon as its chunks are complete, whatever order they
+      // complete in. Returns false without having read anything when io_uring cannot be used, e.g. a kernel or sandbox that does not allow it
+      bool LoadWithUring(std::stop_token const& stop, std::string const& filepath)
+      {
+        io_uring ring;
+        if (io_uring_queue_init(m_queueDepth, &ring, 0) < 0)
+        {
+          return false;
+        }
+
+        int const fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+          io_uring_queue_exit(&ring);
+          return false;
+        }
+        detail::OnExitScope const closeRing{[&ring, fd]()
+                                            {
+                                              ::close(fd);
+                                              io_uring_queue_exit(&ring);
+                                            }};
+
+        struct Chunk
+        {
+          size_t offset;
+          size_t size;
+          size_t bytesRead;
+          bool done;
+        };
+
+        std::vector<Chunk> chunks((m_buffer.size() + m_chunkSize - 1) / m_chunkSize);
+        for (size_t i{}; i < chunks.size(); ++i)
+        {
+          chunks[i] = Chunk{i * m_chunkSize, std::min(m_chunkSize, m_buffer.size() - i * m_chunkSize), 0, false};
+        }
+
+        // Short reads get queued again for the rest of their chunk
+        auto const queueRead = [this, &ring, fd](Chunk& chunk)
+        {
+          io_uring_sqe* const sqe = io_uring_get_sqe(&ring);
+          io_uring_prep_read(sqe, fd, m_buffer.data() + chunk.offset + chunk.bytesRead, static_cast<unsigned>(chunk.size - chunk.bytesRead),
+                             chunk.offset + chunk.bytesRead);
+          io_uring_sqe_set_data(sqe, &chunk);
+        };
+
+        size_t nextChunk{};   // First chunk which has not been queued yet
+        size_t frontChunk{};  // First chunk which is not complete yet
+        size_t nrInFlight{};
+        size_t nrQueued{};
+        bool submittedBefore{false};
+        bool endOfFile{false};
+        bool finished{false};
+        std::optional<XMLError> error;
+        while (true)
+        {
+          bool const stopping = stop.stop_requested() || error.has_value();
+          while (!stopping && !endOfFile && nrInFlight + nrQueued < m_queueDepth && nextChunk < chunks.size())
+          {
+            queueRead(chunks[nextChunk++]);
+            ++nrQueued;
+          }
+
+          if (nrQueued > 0 && !stopping)
+          {
+            int const submitted = io_uring_submit(&ring);
+            if (submitted < 0)
+            {
+              // Nothing was read yet, the plain reads can still take over from the start
+              if (!submittedBefore)
+              {
+                return false;
+              }
+
+              // Whatever is queued never reaches the kernel, only the reads in flight still have to be waited for
+              error = XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Reading from '{}' failed", filepath)};
+            }
+            else
+            {
+              submittedBefore = true;
+              nrInFlight += static_cast<size_t>(submitted);
+              nrQueued -= static_cast<size_t>(submitted);
+            }
+          }
+
+          if (nrInFlight == 0)
+          {
+            break;
+          }
+
+          io_uring_cqe* cqe{};
+          if (int const ret = io_uring_wait_cqe(&ring, &cqe); ret < 0)
+          {
+            if (ret != -EINTR)
+            {
+              error = XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Reading from '{}' failed", filepath)};
+            }
+            continue;
+          }
+
+          Chunk& chunk = *static_cast<Chunk*>(io_uring_cqe_get_data(cqe));
+          int const result = cqe->res;
+          io_uring_cqe_seen(&ring, cqe);
+          --nrInFlight;
+
+          if (result == -EINTR || result == -EAGAIN || (result > 0 && chunk.bytesRead + static_cast<size_t>(result) < chunk.size))
+          {
+            chunk.bytesRead += static_cast<size_t>(std::max(result, 0));
+            if (!stop.stop_requested() && !error.has_value())
+            {
+              queueRead(chunk);
+              ++nrQueued;
+            }
+            continue;
+          }
+
+          if (result < 0)
+          {
+            error = XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Reading from '{}' failed", filepath)};
+            continue;
+          }
+
+          // Reading nothing at all means the file shrank since its size was taken, no chunk behind this one has anything either
+          chunk.bytesRead += static_cast<size_t>(result);
+          chunk.done = true;
+          endOfFile = endOfFile || result == 0;
+
+          // Chunks behind the one the file ended in are not part of it, even when they do read something
+          size_t const previousFront = frontChunk;
+          while (!finished && frontChunk < chunks.size() && chunks[frontChunk].done)
+          {
+            finished = chunks[frontChunk].bytesRead < chunks[frontChunk].size;
+            ++frontChunk;
+          }
+          finished = finished || frontChunk == chunks.size();
+
+          if (frontChunk != previousFront && !error.has_value())
+          {
+            Chunk const& last = chunks[frontChunk - 1];
+            Publish(last.offset + last.bytesRead, finished);
+          }
+        }
+
+        if (error.has_value() && !stop.stop_requested())
+        {
+          Publish(0, true, std::move(error));
+        }
+
+        return true;
+      }
+#endif
+    };
+  }  // namespace
+
+  std::expected<XMLDocument, XMLError> XMLParser::Parse(std::string_view filepath, AsyncRead const& options)
+  {
+    using namespace detail;
+
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    auto result = GetFileSize(filepath).and_then(
+        [this, filepath, &options](size_t size) -> std::expected<XMLDocument, XMLError>
+        {
+          // Nothing to read, and the chunk arithmetic below assumes at least one chunk
+          if (size == 0)
+          {
+            return ParseBuffer({});
+          }
+
+          std::pmr::memory_resource* const resource = m_options.memoryResource;
+          char* text = static_cast<char*>(resource->allocate(size, PAGE_SIZE));
+          OnExitScope const releaseText{[resource, &text, size]()
+                                        {
+                                          if (text)
+                                          {
+                                            resource->deallocate(text, size, PAGE_SIZE);
+                                          }
+                                        }};
+          FXML_INSTRUMENT(m_stats.bytesAllocated += size);
+
+          // Declared after the text, so it is done writing to the text by the time that gets released
+          FileLoader loader{std::span<char>{text, size}, options};
+          CHECK_EXPECTED_VOID(loader.Start(filepath));
+
+          // Filtered and parallel parses need the whole text up front, those only get their file read in the background
+          bool const tokenizeWhileLoading = m_options.filter.empty() && m_options.threadCount == 1;
+
+          Reset();
+
+          // The tokenizer stops at a token which runs past what is loaded and picks it up again once the next chunk is in
+          Tokenizer tokenizer{*this};
+          FileLoader::Progress progress{};
+          while (!progress.finished)
+          {
+            {
+              FXML_INSTRUMENT(ScopedTimer const loadTimer{m_stats.loadTime});
+              CHECK_EXPECTED_NO_TRANSFORM(FileLoader::Progress, next, loader.WaitForMoreThan(progress.loaded));
+              progress = next;
+            }
+
+            if (tokenizeWhileLoading)
+            {
+              FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+              CHECK_EXPECTED_VOID(tokenizer.ParseDocument(std::string_view{text, progress.loaded}, m_bufferPointer, progress.finished));
+            }
+          }
+          FXML_INSTRUMENT(m_stats.bytesScanned = m_bufferPointer);
+
+          XMLSource source{text, progress.loaded,
+                           [resource, size](char const* data, size_t) { resource->deallocate(const_cast<char*>(data), size, PAGE_SIZE); }};
+          text = nullptr;
+
+          auto document = tokenizeWhileLoading ? BuildDocument() : ParseBuffer(source.GetText());
+          return std::move(document).transform([this, &source](XMLDocument&& doc) { return AttachSource(std::move(doc), std::move(source)); });
+        });
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
+  }
+}  // namespace fxml
@@ -0,0 +1,152 @@
+#include "FXMLBatch.h"
+
+#include <algorithm>
+
+namespace fxml
+{
+  XMLBatchParser::Worker::Worker(ParseOptions const& options)
+    : parser(options)
+  {
+  }
+
+  XMLBatchParser::XMLBatchParser(uint32_t threadCount, ParseOptions const& options)
+  {
+    size_t const nrOfThreads = threadCount > 0 ? threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+
+    m_workers.reserve(nrOfThreads);
+    for (size_t i{}; i < nrOfThreads; ++i)
+    {
+      m_workers.push_back(std::make_unique<Worker>(options));
+    }
+
+    // Only start the threads once every worker exists, they steal from each other
+    for (size_t i{}; i < nrOfThreads; ++i)
+    {
+      m_workers[i]->thread = std::jthread{[this, i]() { WorkerLoop(i); }};
+    }
+  }
+
+  XMLBatchParser::~XMLBatchParser()
+  {
+    {
+      std::lock_guard const lock{m_mutex};
+      m_stop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (std::unique_ptr<Worker>& worker : m_workers)
+    {
+      worker->thread.join();
+    }
+  }
+
+  std::vector<std::expected<XMLDocument, XMLError>> XMLBatchParser::ParseMany(std::span<std::string_view const> filepaths)
+  {
+    std::vector<std::expected<XMLDocument, XMLError>> results(filepaths.size());
+    if (filepaths.empty())
+    {
+      return results;
+    }
+
+    std::lock_guard const batchLock{m_batchMutex};
+
+    {
+      std::lock_guard const lock{m_mutex};
+      m_filepaths = filepaths;
+      m_results = &results;
+      m_remaining = filepaths.size();
+
+      // Neighbouring files tend to live next to each other on disk as well, so every worker gets a contiguous run
+      size_t const runSize = (filepaths.size() + m_workers.size() - 1) / m_workers.size();
+      for (size_t i{}; i < m_workers.size(); ++i)
+      {
+        std::lock_guard const workerLock{m_workers[i]->mutex};
+        for (size_t task{i * runSize}; task < std::min((i + 1) * runSize, filepaths.size()); ++task)
+        {
+          m_workers[i]->tasks.push_back(task);
+        }
+      }
+
+      ++m_batch;
+    }
+    m_wakeUp.notify_all();
+
+    std::unique_lock lock{m_mutex};
+    m_batchDone.wait(lock, [this]() { return m_remaining == 0; });
+
+    m_filepaths = {};
+    m_results = nullptr;
+
+    return results;
+  }
+
+  std::vector<std::expected<XMLDocument, XMLError>> XMLBatchParser::ParseMany(std::span<std::string const> filepaths)
+  {
+    std::vector<std::string_view> const views(filepaths.begin(), filepaths.end());
+    return ParseMany(std::span<std::string_view const>{views});
+  }
+
+  size_t XMLBatchParser::GetNrOfThreads() const
+  {
+    return m_workers.size();
+  }
+
+  void XMLBatchParser::WorkerLoop(size_t workerIndex)
+  {
+    Worker& worker = *m_workers[workerIndex];
+
+    uint64_t batch{};
+    while (true)
+    {
+      {
+        std::unique_lock lock{m_mutex};
+        m_wakeUp.wait(lock, [this, batch]() { return m_stop || m_batch != batch; });
+        if (m_stop)
+        {
+          return;
+        }
+        batch = m_batch;
+      }
+
+      while (std::optional<size_t> const task = NextTask(workerIndex))
+      {
+        (*m_results)[*task] = worker.parser.Parse(m_filepaths[*task]);
+
+        if (m_remaining.fetch_sub(1) == 1)
+        {
+          std::lock_guard const lock{m_mutex};
+          m_batchDone.notify_all();
+        }
+      }
+    }
+  }
+
+  std::optional<size_t> XMLBatchParser::NextTask(size_t workerIndex)
+  {
+    {
+      Worker& worker = *m_workers[workerIndex];
+      std::lock_guard const lock{worker.mutex};
+      if (!worker.tasks.empty())
+      {
+        size_t const task = worker.tasks.front();
+        worker.tasks.pop_front();
+        return task;
+      }
+    }
+
+    // Out of work, steal from the back so the owner and the thief do not fight over the same end
+    for (size_t offset{1}; offset < m_workers.size(); ++offset)
+    {
+      Worker& victim = *m_workers[(workerIndex + offset) % m_workers.size()];
+      std::lock_guard const lock{victim.mutex};
+      if (!victim.tasks.empty())
+      {
+        size_t const task = victim.tasks.back();
+        victim.tasks.pop_back();
+        return task;
+      }
+    }
+
+    return std::nullopt;
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "FXMLBinding.h"
+
+#include <format>
+#include <string>
+#include <vector>
+
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  namespace detail
+  {
+    namespace
+    {
+      // Tokenizer handler which writes straight into the bound structs
+      class BindingParser
+      {
+       private:
+        // An open element, bound to a struct ('table'), to a scalar member ('field') or to nothing at all
+        struct Frame
+        {
+          std::string_view name;
+          void* object;
+          BindingTable const* table;
+          BoundField const* field;
+        };
+
+       private:
+        void* m_root;
+        BindingTable const& m_rootTable;
+        bool m_rootSeen = false;
+        std::vector<Frame> m_frames;
+        std::string m_decoded;  // Scratch for text with references in it
+
+        // Text of the open element bound to a scalar, there is at most one as their children are not bound. Comments and CDATA sections
+        // split it into pieces, a single piece is kept as a view and only more than one gets joined in 'm_decoded'
+        std::string_view m_firstText;
+        bool m_firstTextIsLiteral = false;
+        size_t m_nrOfTextPieces = 0;
+
+       public:
+        BindingParser(void* root, BindingTable const& rootTable)
+          : m_root(root)
+          , m_rootTable(rootTable)
+        {
+        }
+
+        std::expected<void, XMLError> Finish() const
+        {
+          if (!m_frames.empty())
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", m_frames.back().name)}};
+          }
+
+          if (!m_rootSeen)
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Root element '{}' not found", m_rootTable.name)}};
+          }
+
+          RETURN_OK();
+        }
+
+        // ==============================
+        // ====== TOKENIZER EVENTS ======
+        // ==============================
+        bool HasOpenElement() const
+        {
+          return !m_frames.empty();
+        }
+
+        std::expected<void, XMLError> OnRawStartTag(std::string_view name, std::string_view rawTag, bool isEmptyElement)
+        {
+          Frame frame{name, nullptr, nullptr, nullptr};
+          if (m_frames.empty())
+          {
+            if (m_rootSeen || name != m_rootTable.name)
+            {
+              return std::unexpected{XMLError{ErrorReason::PARSE_ERROR,
+                                              std::format("Expected a single root element '{}', found '{}'", m_rootTable.name, name)}};
+            }
+
+            m_rootSeen = true;
+            frame.object = m_root;
+            frame.table = &m_rootTable;
+          }
+          else if (Frame const& parent = m_frames.back(); parent.table)
+          {
+            if (BoundField const* field = parent.table->Find(name, BoundFieldKind::ELEMENT))
+            {
+              if (field->child)
+              {
+                frame.object = field->child(parent.object);
+                frame.table = &field->childTable();
+              }
+              else
+              {
+                frame.object = parent.object;
+                frame.field = field;
+              }
+            }
+          }
+
+          // Only elements bound to a struct have their attributes looked at
+          if (frame.table && !frame.table->fields.empty())
+          {
+            size_t offset{name.size() + 1};
+            while (true)
+            {
+              CHECK_EXPECTED(std::optional<XMLAttribute>, attribute, NextAttribute(rawTag, offset),
+                             std::format("Attribute in tag '{}' is malformed", name));
+              if (!attribute.has_value())
+              {
+                break;
+              }
+
+              if (BoundField const* field = frame.table->Find(attribute->key, BoundFieldKind::ATTRIBUTE))
+              {
+                CHECK_EXPECTED_VOID(Set(frame.object, *field, attribute->value, false));
+              }
+            }
+          }
+
+          if (isEmptyElement)
+          {
+            if (frame.field)
+            {
+              return Set(frame.object, *frame.field, {}, false);
+            }
+
+            RETURN_OK();
+          }
+
+          if (frame.field)
+          {
+            m_nrOfTextPieces = 0;
+          }
+          m_frames.push_back(frame);
+
+          RETURN_OK();
+        }
+
+        std::expected<void, XMLError> OnEndTag(std::string_view name)
+        {
+          if (m_frames.back().name != name)
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+          }
+
+          // A scalar gets set once per element, with all of its text
+          Frame const frame = m_frames.back();
+          m_frames.pop_back();
+          if (!frame.field)
+          {
+            RETURN_OK();
+          }
+
+          if (m_nrOfTextPieces <= 1)
+          {
+            return Set(frame.object, *frame.field, m_nrOfTextPieces == 0 ? std::string_view{} : m_firstText, m_firstTextIsLiteral);
+          }
+          if (frame.field->rawText)
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR,
+                                            std::format("Text of '{}' is split by comments or CDATA sections, a view cannot hold it", name)}};
+          }
+
+          return frame.field->set(frame.object, m_decoded);
+        }
+
+        std::expected<void, XMLError> OnContent(std::string_view content)
+        {
+          Frame const& frame = m_frames.back();
+          if (!frame.field)
+          {
+            RETURN_OK();
+          }
+
+          bool const isLiteral = IsCDataText(content);
+          if (m_nrOfTextPieces == 0)
+          {
+            m_firstText = content;
+            m_firstTextIsLiteral = isLiteral;
+          }
+          else
+          {
+            if (m_nrOfTextPieces == 1)
+            {
+              m_decoded.clear();
+              AppendText(m_firstText, m_firstTextIsLiteral);
+            }
+            AppendText(content, isLiteral);
+          }
+          ++m_nrOfTextPieces;
+
+          RETURN_OK();
+        }
+
+        std::expected<void, XMLError> OnComment(std::string_view)
+        {
+          RETURN_OK();
+        }
+
+       private:
+        std::expected<void, XMLError> Set(void* object, BoundField const& field, std::string_view text, bool isLiteral)
+        {
+          if (field.rawText || isLiteral || FindFirstOf(text, REFERENCE_START_CHARS) == std::string_view::npos)
+          {
+            return field.set(object, text);
+          }
+
+          m_decoded.clear();
+          DecodeReferences(text, m_decoded);
+          return field.set(object, m_decoded);
+        }
+
+        void AppendText(std::string_view text, bool isLiteral)
+        {
+          if (isLiteral)
+          {
+            m_decoded.append(text);
+          }
+          else
+          {
+            DecodeReferences(text, m_decoded);
+          }
+        }
+      };
+    }  // namespace
+
+    std::expected<void, XMLError> ParseBound(std::string_view xml, void* object, BindingTable const& table)
+    {
+      BindingParser parser{object, table};
+
+      size_t bufferPointer{};
+      CHECK_EXPECTED_VOID(Tokenizer{parser}.ParseDocument(xml, bufferPointer));
+
+      return parser.Finish();
+    }
+  }  // namespace detail
+}  // namespace fxml
\ No newline at end of file
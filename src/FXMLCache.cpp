@@ -0,0 +1,293 @@
+#include "FXMLCache.h"
+
+#include <optional>
+#include <vector>
+
+#include "FXMLUtils.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stop_token>
+#include <thread>
+#endif
+
+namespace fxml
+{
+#ifdef __linux__
+  // Reports every change to a watched file to the cache, from a thread of its own
+  class XMLDocumentCache::Watcher
+  {
+   private:
+    static constexpr uint32_t EVENTS = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+
+    XMLDocumentCache& m_cache;
+    int m_inotify;
+    int m_wakeUp;
+
+    std::mutex m_mutex;
+    std::unordered_map<int, std::vector<std::string>> m_paths;  // Per watch descriptor, links to the same file share one
+    std::unordered_map<std::string, int> m_watches;
+
+    std::jthread m_thread;
+
+   public:
+    static std::unique_ptr<Watcher> Create(XMLDocumentCache& cache)
+    {
+      int const inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (inotify == -1)
+      {
+        return nullptr;
+      }
+
+      int const wakeUp = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (wakeUp == -1)
+      {
+        close(inotify);
+        return nullptr;
+      }
+
+      return std::unique_ptr<Watcher>{new Watcher{cache, inotify, wakeUp}};
+    }
+
+    ~Watcher()
+    {
+      m_thread.request_stop();
+      uint64_t const one{1};
+      [[maybe_unused]] ssize_t const written = write(m_wakeUp, &one, sizeof(one));
+      m_thread.join();
+
+      close(m_wakeUp);
+      close(m_inotify);
+    }
+
+    Watcher(Watcher const&) = delete;
+    Watcher& operator=(Watcher const&) = delete;
+
+    bool Watch(std::string const& path)
+    {
+      std::lock_guard const lock{m_mutex};
+      if (m_watches.contains(path))
+      {
+        return true;
+      }
+
+      int const descriptor = inotify_add_watch(m_inotify, path.c_str(), EVENTS);
+      if (descriptor == -1)
+      {
+        return false;
+      }
+
+      m_paths[descriptor].push_back(path);
+      m_watches.emplace(path, descriptor);
+      return true;
+    }
+
+   private:
+    Watcher(XMLDocumentCache& cache, int inotify, int wakeUp)
+      : m_cache(cache)
+      , m_inotify(inotify)
+      , m_wakeUp(wakeUp)
+    {
+      m_thread = std::jthread{[this](std::stop_token stopToken) { Run(stopToken); }};
+    }
+
+    void Run(std::stop_token stopToken)
+    {
+      alignas(inotify_event) char buffer[4096];
+      pollfd descriptors[2] = {{m_inotify, POLLIN, 0}, {m_wakeUp, POLLIN, 0}};
+
+      while (!stopToken.stop_requested())
+      {
+        if (poll(descriptors, 2, -1) == -1 && errno != EINTR)
+        {
+          return;
+        }
+
+        ssize_t length{};
+        while (!stopToken.stop_requested() && (length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+          for (char const* p = buffer; p < buffer + length;)
+          {
+            inotify_event const* const event = reinterpret_cast<inotify_event const*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            // Events got dropped, any watched entry may have missed its change and would never check the file again
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+              m_cache.Clear();
+              continue;
+            }
+
+            std::vector<std::string> paths;
+            {
+              std::lock_guard const lock{m_mutex};
+              auto const it = m_paths.find(event->wd);
+              if (it == m_paths.end())
+              {
+                continue;
+              }
+              paths = it->second;
+
+              // The watch is gone or follows a file which is not at its path anymore, the next Get watches the path again
+              if (event->mask & (IN_IGNORED | IN_MOVE_SELF | IN_DELETE_SELF))
+              {
+                if (!(event->mask & IN_IGNORED))
+                {
+                  inotify_rm_watch(m_inotify, event->wd);
+                }
+                for (std::string const& path : it->second)
+                {
+                  m_watches.erase(path);
+                }
+                m_paths.erase(it);
+              }
+            }
+
+            for (std::string const& path : paths)
+            {
+              m_cache.Invalidate(path);
+            }
+          }
+        }
+      }
+    }
+  };
+#else
+  // No file watching on this platform, every hit checks the file instead
+  class XMLDocumentCache::Watcher
+  {
+   public:
+    static std::unique_ptr<Watcher> Create(XMLDocumentCache&)
+    {
+      return nullptr;
+    }
+
+    bool Watch(std::string const&)
+    {
+      return false;
+    }
+  };
+#endif
+
+  XMLDocumentCache::XMLDocumentCache(ParseOptions const& options, bool watchFiles)
+    : m_options(options)
+    , m_watcher(watchFiles ? Watcher::Create(*this) : nullptr)
+  {
+  }
+
+  XMLDocumentCache::~XMLDocumentCache() = default;
+
+  std::expected<XMLDocumentCache::DocumentPtr, XMLError> XMLDocumentCache::Get(std::string_view filepath)
+  {
+    using namespace detail;
+
+    std::string const path{filepath};
+
+    uint64_t nrOfInvalidations{};
+    std::optional<PendingDocument> hit;
+    {
+      std::lock_guard const lock{m_mutex};
+      if (auto const it = m_entries.find(path); it != m_entries.end() && it->second.watched)
+      {
+        hit = it->second.document;
+      }
+      nrOfInvalidations = m_nrOfInvalidations;
+    }
+
+    if (hit.has_value())
+    {
+      return hit->get();
+    }
+
+    // Watch before looking at the file, so a change right after the check still gets reported
+    bool const watched = m_watcher && m_watcher->Watch(path);
+
+    auto const size = GetFileSize(path);
+    auto const lastWriteTime = size.and_then([&path](size_t) { return GetLastWriteTime(path); });
+    if (!lastWriteTime.has_value())
+    {
+      Invalidate(path);
+      return std::unexpected{lastWriteTime.error()};
+    }
+
+    std::promise<std::expected<DocumentPtr, XMLError>> promise;
+    PendingDocument document;
+    uint64_t generation{};
+    bool parseHere{false};
+    {
+      std::lock_guard const lock{m_mutex};
+
+      // A change reported while the file was being checked may have happened before the check, such an entry keeps getting checked
+      bool const canTrustWatch = watched && nrOfInvalidations == m_nrOfInvalidations;
+
+      auto const it = m_entries.find(path);
+      if (it != m_entries.end() && it->second.size == *size && it->second.lastWriteTime == *lastWriteTime)
+      {
+        document = it->second.document;
+        it->second.watched = it->second.watched || canTrustWatch;
+      }
+      else
+      {
+        generation = m_nextGeneration++;
+        document = promise.get_future().share();
+        m_entries.insert_or_assign(path, Entry{*size, *lastWriteTime, generation, document, canTrustWatch});
+        parseHere = true;
+      }
+    }
+
+    if (parseHere)
+    {
+      // Const lookups build the index lazily, which is a race once the document is shared, so it gets built before anyone can see it
+      auto result = XMLParser{m_options}.Parse(path).transform(
+          [](XMLDocument&& doc)
+          {
+            doc.BuildIndex();
+            return std::make_shared<XMLDocument const>(std::move(doc));
+          });
+
+      // Failures are not cached, the next Get tries again
+      if (!result.has_value())
+      {
+        std::lock_guard const lock{m_mutex};
+        if (auto const it = m_entries.find(path); it != m_entries.end() && it->second.generation == generation)
+        {
+          m_entries.erase(it);
+        }
+      }
+
+      promise.set_value(std::move(result));
+    }
+
+    return document.get();
+  }
+
+  void XMLDocumentCache::Invalidate(std::string_view filepath)
+  {
+    std::lock_guard const lock{m_mutex};
+    ++m_nrOfInvalidations;
+    m_entries.erase(std::string{filepath});
+  }
+
+  void XMLDocumentCache::Clear()
+  {
+    std::lock_guard const lock{m_mutex};
+    ++m_nrOfInvalidations;
+    m_entries.clear();
+  }
+
+  size_t XMLDocumentCache::GetNrOfDocuments() const
+  {
+    std::lock_guard const lock{m_mutex};
+    return m_entries.size();
+  }
+
+  bool XMLDocumentCache::IsWatchingFiles() const
+  {
+    return m_watcher != nullptr;
+  }
+}  // namespace fxml
\ No newline at end of file
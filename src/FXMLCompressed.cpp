@@ -0,0 +1,577 @@
+#include "FXMLCompressed.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <limits>
+
+#include "FXMLData.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+// Set by CMake for every compression library it found
+#ifndef FXML_HAS_ZLIB
+#define FXML_HAS_ZLIB 0
+#endif
+#ifndef FXML_HAS_ZSTD
+#define FXML_HAS_ZSTD 0
+#endif
+
+#if FXML_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#if FXML_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace fxml
+{
+  namespace
+  {
+    // Compressed bytes read from the file at a time
+    constexpr size_t INPUT_SIZE = 64 * 1024;
+
+    // Large enough for the magic number of every format and a complete zstd frame header
+    constexpr size_t HEADER_SIZE = 18;
+
+    // Highest uncompressed size per compressed byte a size hint is believed for. XML rarely gets past this, so a larger hint is more likely
+    // a crafted header than a real file
+    constexpr size_t MAX_COMPRESSION_RATIO = 32;
+
+    constexpr std::array<unsigned char, 2> GZIP_MAGIC = {0x1f, 0x8b};
+    constexpr std::array<unsigned char, 4> ZSTD_MAGIC = {0x28, 0xb5, 0x2f, 0xfd};
+
+    template <size_t N>
+    bool StartsWith(std::span<char const> header, std::array<unsigned char, N> const& magic)
+    {
+      return header.size() >= N && std::memcmp(header.data(), magic.data(), N) == 0;
+    }
+
+    std::string_view GetName(Compression compression)
+    {
+      switch (compression)
+      {
+        case Compression::GZIP:
+          return "gzip";
+        case Compression::ZSTD:
+          return "zstd";
+        default:
+          return "uncompressed";
+      }
+    }
+  }  // namespace
+
+  // Turns the bytes of the file into uncompressed bytes, one call per piece of input or output
+  class XMLCompressedReader::Decoder
+  {
+   public:
+    struct Result
+    {
+      size_t consumed;  // Bytes of the input that were used up
+      size_t produced;  // Bytes written to the output
+      bool finished;    // Everything is decompressed, only set once the last input was handed over
+    };
+
+   private:
+    Compression m_compression;
+
+#if FXML_HAS_ZLIB
+    z_stream m_gzip{};
+    bool m_memberEnded = false;
+#endif
+
+#if FXML_HAS_ZSTD
+    ZSTD_DStream* m_zstd = nullptr;
+    size_t m_zstdHint = 1;  // 0 once a frame is completely decompressed and flushed
+#endif
+
+   public:
+    explicit Decoder(Compression compression)
+      : m_compression(compression)
+    {
+    }
+
+    ~Decoder()
+    {
+#if FXML_HAS_ZLIB
+      if (m_compression == Compression::GZIP)
+      {
+        inflateEnd(&m_gzip);
+      }
+#endif
+#if FXML_HAS_ZSTD
+      ZSTD_freeDStream(m_zstd);
+#endif
+    }
+
+    Decoder(Decoder const&) = delete;
+    Decoder& operator=(Decoder const&) = delete;
+
+    std::expected<void, std::string> Init()
+    {
+      switch (m_compression)
+      {
+#if FXML_HAS_ZLIB
+        case Compression::GZIP:
+          // 32 on top of the window bits detects the gzip header
+          if (inflateInit2(&m_gzip, 15 + 32) != Z_OK)
+          {
+            return std::unexpected{"could not set up zlib"};
+          }
+          break;
+#endif
+#if FXML_HAS_ZSTD
+        case Compression::ZSTD:
+          m_zstd = ZSTD_createDStream();
+          if (!m_zstd || ZSTD_isError(ZSTD_initDStream(m_zstd)))
+          {
+            return std::unexpected{"could not set up zstd"};
+          }
+          break;
+#endif
+        default:
+          break;
+      }
+
+      return {};
+    }
+
+    // 'endOfInput' is set once 'input' holds the last bytes of the file
+    std::expected<Result, std::string> Decode(std::span<char const> input, std::span<char> output, bool endOfInput)
+    {
+      switch (m_compression)
+      {
+#if FXML_HAS_ZLIB
+        case Compression::GZIP:
+          return DecodeGzip(input, output, endOfInput);
+#endif
+#if FXML_HAS_ZSTD
+        case Compression::ZSTD:
+          return DecodeZstd(input, output, endOfInput);
+#endif
+        default:
+        {
+          size_t const size = std::min(input.size(), output.size());
+          std::memcpy(output.data(), input.data(), size);
+          return Result{size, size, endOfInput && size == input.size()};
+        }
+      }
+    }
+
+   private:
+#if FXML_HAS_ZLIB
+    std::expected<Result, std::string> DecodeGzip(std::span<char const> input, std::span<char> output, bool endOfInput)
+    {
+      // Concatenated gzip files are one stream, whatever follows the end of a member is the next member
+      if (m_memberEnded)
+      {
+        if (input.empty())
+        {
+          return Result{0, 0, endOfInput};
+        }
+
+        inflateReset(&m_gzip);
+        m_memberEnded = false;
+      }
+
+      uInt const inputSize = static_cast<uInt>(std::min<size_t>(input.size(), std::numeric_limits<uInt>::max()));
+      uInt const outputSize = static_cast<uInt>(std::min<size_t>(output.size(), std::numeric_limits<uInt>::max()));
+      m_gzip.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+      m_gzip.avail_in = inputSize;
+      m_gzip.next_out = reinterpret_cast<Bytef*>(output.data());
+      m_gzip.avail_out = outputSize;
+
+      int const ret = inflate(&m_gzip, Z_NO_FLUSH);
+      Result result{inputSize - m_gzip.avail_in, outputSize - m_gzip.avail_out, false};
+      switch (ret)
+      {
+        case Z_STREAM_END:
+          m_memberEnded = true;
+          result.finished = endOfInput && result.consumed == input.size();
+          return result;
+        case Z_OK:
+          return result;
+        case Z_BUF_ERROR:
+          // No progress possible, which is fine unless no more input is coming
+          if (endOfInput && result.consumed == input.size() && result.produced == 0)
+          {
+            return std::unexpected{"unexpected end of data"};
+          }
+          return result;
+        default:
+          return std::unexpected{m_gzip.msg ? std::string(m_gzip.msg) : std::format("zlib error {}", ret)};
+      }
+    }
+#endif
+
+#if FXML_HAS_ZSTD
+    std::expected<Result, std::string> DecodeZstd(std::span<char const> input, std::span<char> output, bool endOfInput)
+    {
+      if (input.empty() && endOfInput && m_zstdHint == 0)
+      {
+        return Result{0, 0, true};
+      }
+
+      // A file holding several frames needs no special handling, the stream continues with the next one
+      ZSTD_inBuffer in{input.data(), input.size(), 0};
+      ZSTD_outBuffer out{output.data(), output.size(), 0};
+      size_t const ret = ZSTD_decompressStream(m_zstd, &out, &in);
+      if (ZSTD_isError(ret))
+      {
+        return std::unexpected{std::string(ZSTD_getErrorName(ret))};
+      }
+
+      m_zstdHint = ret;
+      if (ret != 0 && endOfInput && in.pos == input.size() && out.pos == 0)
+      {
+        return std::unexpected{"unexpected end of data"};
+      }
+
+      return Result{in.pos, out.pos, ret == 0 && endOfInput && in.pos == input.size()};
+    }
+#endif
+  };
+
+  XMLCompressedReader::XMLCompressedReader(size_t blockSize, size_t nrOfBlocks)
+    : m_blockSize(blockSize > 0 ? blockSize : DEFAULT_BLOCK_SIZE)
+    , m_blocks(std::max<size_t>(nrOfBlocks, 1))
+    , m_finished(true)
+  {
+  }
+
+  XMLCompressedReader::~XMLCompressedReader()
+  {
+    Close();
+  }
+
+  bool XMLCompressedReader::IsSupported(Compression compression)
+  {
+    switch (compression)
+    {
+      case Compression::GZIP:
+        return FXML_HAS_ZLIB;
+      case Compression::ZSTD:
+        return FXML_HAS_ZSTD;
+      default:
+        return true;
+    }
+  }
+
+  std::expected<void, XMLError> XMLCompressedReader::Open(std::string_view filepath)
+  {
+    using namespace detail;
+
+    Close();
+
+    CHECK_EXPECTED_NO_TRANSFORM(size_t, fileSize, GetFileSize(filepath));
+
+    std::ifstream file{std::string(filepath), std::ios::binary};
+    if (!file.is_open())
+    {
+      return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
+    }
+
+    std::array<char, HEADER_SIZE> header{};
+    file.read(header.data(), static_cast<std::streamsize>(header.size()));
+    std::span<char const> const headerBytes{header.data(), static_cast<size_t>(file.gcount())};
+
+    m_compression = StartsWith(headerBytes, GZIP_MAGIC)   ? Compression::GZIP
+                    : StartsWith(headerBytes, ZSTD_MAGIC) ? Compression::ZSTD
+                                                          : Compression::NONE;
+    if (!IsSupported(m_compression))
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT,
+                                      std::format("'{}' is {} compressed, which this build cannot decompress", filepath, GetName(m_compression))}};
+    }
+
+    m_sizeHint = 0;
+    switch (m_compression)
+    {
+      case Compression::GZIP:
+        // The trailer of the last member ends in its uncompressed size, little-endian
+        if (fileSize >= HEADER_SIZE)
+        {
+          std::array<unsigned char, 4> trailer{};
+          file.clear();
+          file.seekg(static_cast<std::streamoff>(fileSize - trailer.size()));
+          file.read(reinterpret_cast<char*>(trailer.data()), static_cast<std::streamsize>(trailer.size()));
+          m_sizeHint = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | static_cast<size_t>(trailer[3]) << 24;
+        }
+        break;
+      case Compression::ZSTD:
+#if FXML_HAS_ZSTD
+        if (unsigned long long const size = ZSTD_getFrameContentSize(headerBytes.data(), headerBytes.size());
+            size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR)
+        {
+          m_sizeHint = static_cast<size_t>(size);
+        }
+#endif
+        break;
+      default:
+        m_sizeHint = fileSize;
+        break;
+    }
+
+    // The recorded size comes from the file itself, a few bytes can claim exabytes. Anything beyond the cap is left to the readers growing
+    m_sizeHint = std::min(m_sizeHint, std::max(fileSize * MAX_COMPRESSION_RATIO, DEFAULT_BLOCK_SIZE));
+
+    file.clear();
+    file.seekg(0);
+
+    auto decoder = std::make_unique<Decoder>(m_compression);
+    if (auto const ret = decoder->Init(); !ret.has_value())
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, std::format("Could not decompress '{}': {}", filepath, ret.error())}};
+    }
+
+    for (Block& block : m_blocks)
+    {
+      block.data.resize(m_blockSize);
+      block.size = 0;
+    }
+    m_firstReadyBlock = 0;
+    m_nrOfReadyBlocks = 0;
+    m_readOffset = 0;
+    m_finished = false;
+    m_stop = false;
+    m_error.reset();
+
+    m_thread = std::jthread{[this, file = std::move(file), decoder = std::move(decoder), path = std::string(filepath)]() mutable
+                            { DecompressLoop(std::move(file), std::move(decoder), std::move(path)); }};
+
+    RETURN_OK();
+  }
+
+  void XMLCompressedReader::Close()
+  {
+    {
+      std::lock_guard const lock{m_mutex};
+      m_stop = true;
+    }
+    m_blockFree.notify_all();
+
+    if (m_thread.joinable())
+    {
+      m_thread.join();
+    }
+
+    // Reads after a close see the end of the input
+    m_nrOfReadyBlocks = 0;
+    m_finished = true;
+  }
+
+  std::expected<size_t, XMLError> XMLCompressedReader::Read(std::span<char> chunk)
+  {
+    size_t written{};
+
+    std::unique_lock lock{m_mutex};
+    while (written < chunk.size())
+    {
+      if (m_nrOfReadyBlocks == 0)
+      {
+        if (written > 0)
+        {
+          break;
+        }
+
+        m_blockReady.wait(lock, [this]() { return m_nrOfReadyBlocks > 0 || m_finished; });
+        if (m_nrOfReadyBlocks == 0)
+        {
+          // Everything that was decompressed before an error still gets read
+          if (m_error.has_value())
+          {
+            return std::unexpected{*m_error};
+          }
+
+          break;
+        }
+      }
+
+      // A ready block is left alone by the decompressor, so the copy does not need the lock
+      Block const& block = m_blocks[m_firstReadyBlock];
+      size_t const size = std::min(block.size - m_readOffset, chunk.size() - written);
+      lock.unlock();
+      std::memcpy(chunk.data() + written, block.data.data() + m_readOffset, size);
+      lock.lock();
+
+      written += size;
+      m_readOffset += size;
+      if (m_readOffset == block.size)
+      {
+        m_readOffset = 0;
+        m_firstReadyBlock = (m_firstReadyBlock + 1) % m_blocks.size();
+        --m_nrOfReadyBlocks;
+        m_blockFree.notify_one();
+      }
+    }
+
+    return written;
+  }
+
+  Compression XMLCompressedReader::GetCompression() const
+  {
+    return m_compression;
+  }
+
+  size_t XMLCompressedReader::GetSizeHint() const
+  {
+    return m_sizeHint;
+  }
+
+  void XMLCompressedReader::DecompressLoop(std::ifstream file, std::unique_ptr<Decoder> decoder, std::string filepath)
+  {
+    std::vector<char> input(INPUT_SIZE);
+    size_t inputBegin{};
+    size_t inputEnd{};
+    bool endOfInput{false};
+
+    bool finished{false};
+    std::optional<XMLError> error;
+    while (!finished && !error.has_value())
+    {
+      size_t blockIndex{};
+      {
+        std::unique_lock lock{m_mutex};
+        m_blockFree.wait(lock, [this]() { return m_stop || m_nrOfReadyBlocks < m_blocks.size(); });
+        if (m_stop)
+        {
+          return;
+        }
+
+        blockIndex = (m_firstReadyBlock + m_nrOfReadyBlocks) % m_blocks.size();
+      }
+
+      // The block right behind the ready ones belongs to this thread until it gets published
+      Block& block = m_blocks[blockIndex];
+      block.size = 0;
+      while (block.size < block.data.size() && !finished)
+      {
+        if (inputBegin == inputEnd && !endOfInput)
+        {
+          file.read(input.data(), static_cast<std::streamsize>(input.size()));
+          if (file.bad())
+          {
+            error = XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Reading from '{}' failed", filepath)};
+            break;
+          }
+
+          inputBegin = 0;
+          inputEnd = static_cast<size_t>(file.gcount());
+          endOfInput = inputEnd < input.size();
+        }
+
+        auto const result = decoder->Decode(std::span<char const>{input}.subspan(inputBegin, inputEnd - inputBegin),
+                                            std::span<char>{block.data}.subspan(block.size), endOfInput);
+        if (!result.has_value())
+        {
+          error = XMLError{ErrorReason::PARSE_ERROR, std::format("Could not decompress '{}': {}", filepath, result.error())};
+          break;
+        }
+
+        inputBegin += result->consumed;
+        block.size += result->produced;
+        finished = result->finished;
+      }
+
+      std::lock_guard const lock{m_mutex};
+      if (block.size > 0)
+      {
+        ++m_nrOfReadyBlocks;
+      }
+      m_finished = finished || error.has_value();
+      m_error = std::move(error);
+      m_blockReady.notify_one();
+    }
+  }
+
+  std::expected<XMLDocument, XMLError> XMLParser::ParseCompressed(std::string_view filepath)
+  {
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    XMLCompressedReader reader;
+    auto result = reader.Open(filepath).and_then([this, &reader]() { return ParseStream(reader); });
+
+    FXML_INSTRUMENT(ReportStats());
+    return result;
+  }
+
+  std::expected<XMLDocument, XMLError> XMLParser::ParseStream(XMLCompressedReader& reader)
+  {
+    using namespace detail;
+
+    // One byte more than the hint, so a hint which is spot on still leaves room to see the end of the input without growing
+    std::pmr::memory_resource* const resource = m_options.memoryResource;
+    size_t capacity = (reader.GetSizeHint() > 0 ? reader.GetSizeHint() : XMLCompressedReader::DEFAULT_BLOCK_SIZE) + 1;
+    char* text = static_cast<char*>(resource->allocate(capacity, 1));
+    OnExitScope releaseText{[resource, &text, &capacity]()
+                            {
+                              if (text)
+                              {
+                                resource->deallocate(text, capacity, 1);
+                              }
+                            }};
+
+    // Filtered and parallel parses need the whole text up front, those only get their input decompressed in the background
+    bool const tokenizeWhileReading = m_options.filter.empty() && m_options.threadCount == 1;
+
+    Reset();
+
+    Tokenizer tokenizer{*this};
+    size_t end{};
+    bool finalChunk{false};
+    while (!finalChunk)
+    {
+      if (end == capacity)
+      {
+        char* const grown = static_cast<char*>(resource->allocate(capacity * 2, 1));
+        std::memcpy(grown, text, end);
+        RebaseViews(text, end, grown);
+        resource->deallocate(text, capacity, 1);
+        text = grown;
+        capacity *= 2;
+      }
+
+      CHECK_EXPECTED_NO_TRANSFORM(size_t, bytesRead, reader.Read(std::span<char>{text + end, capacity - end}));
+      end += bytesRead;
+      finalChunk = bytesRead == 0;
+
+      if (tokenizeWhileReading)
+      {
+        FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+        CHECK_EXPECTED_VOID(tokenizer.ParseDocument(std::string_view{text, end}, m_bufferPointer, finalChunk));
+      }
+    }
+    FXML_INSTRUMENT(m_stats.bytesScanned = m_bufferPointer);
+    FXML_INSTRUMENT(m_stats.bytesAllocated += capacity);
+
+    XMLSource source{text, end, [resource, capacity](char const* data, size_t) { resource->deallocate(const_cast<char*>(data), capacity, 1); }};
+    text = nullptr;
+
+    auto document = tokenizeWhileReading ? BuildDocument() : ParseBuffer(source.GetText());
+    return std::move(document).transform([this, &source](XMLDocument&& doc) { return AttachSource(std::move(doc), std::move(source)); });
+  }
+
+  void XMLParser::RebaseViews(char const* from, size_t size, char const* to)
+  {
+    auto const rebase = [from, size, to](std::string_view& view)
+    {
+      if (view.data() >= from && view.data() <= from + size)
+      {
+        view = std::string_view{to + (view.data() - from), view.size()};
+      }
+    };
+
+    for (XMLElement& element : m_elements)
+    {
+      rebase(element.m_tag.name);
+      rebase(element.m_rawContent);
+    }
+    for (XMLAttribute& attribute : m_attributes)
+    {
+      rebase(attribute.key);
+      rebase(attribute.value);
+    }
+  }
+}  // namespace fxml
@@ -0,0 +1,243 @@
+#include "FXMLCorpus.h"
+
+#include <array>
+#include <format>
+
+namespace fxml
+{
+  namespace
+  {
+    constexpr std::array<std::string_view, 16> WORDS = {"lorem", "ipsum",   "dolor", "sit",    "amet",    "consectetur", "adipiscing", "elit",
+                                                        "sed",   "eiusmod", "tempor", "magna", "aliqua", "veniam",      "nostrud",    "ullamco"};
+    constexpr std::array<std::string_view, 4> REFERENCES = {"&amp;", "&lt;", "&#x41;", "&quot;"};
+
+    class CorpusWriter
+    {
+     private:
+      std::string m_out;
+      size_t m_targetSize;
+      uint64_t m_state;
+
+     public:
+      CorpusWriter(size_t targetSize, uint64_t seed)
+        : m_targetSize(targetSize)
+        , m_state(seed)
+      {
+        m_out.reserve(targetSize + targetSize / 8);
+      }
+
+      bool IsFull() const
+      {
+        return m_out.size() >= m_targetSize;
+      }
+
+      // splitmix64, same sequence on every platform
+      uint64_t Next()
+      {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+      }
+
+      // In [min, max]
+      size_t Between(size_t min, size_t max)
+      {
+        return min + static_cast<size_t>(Next() % (max - min + 1));
+      }
+
+      void Append(std::string_view text)
+      {
+        m_out.append(text);
+      }
+
+      void AppendWords(size_t count, bool withReferences = false)
+      {
+        for (size_t i{}; i < count; ++i)
+        {
+          if (i > 0)
+          {
+            m_out.push_back(' ');
+          }
+
+          if (withReferences && Next() % 32 == 0)
+          {
+            m_out.append(REFERENCES[Next() % REFERENCES.size()]);
+          }
+          else
+          {
+            m_out.append(WORDS[Next() % WORDS.size()]);
+          }
+        }
+      }
+
+      std::string Finish()
+      {
+        return std::move(m_out);
+      }
+    };
+
+    void GenerateDeepNesting(CorpusWriter& writer)
+    {
+      while (!writer.IsFull())
+      {
+        size_t const depth = writer.Between(64, 512);
+        for (size_t i{}; i < depth; ++i)
+        {
+          writer.Append(std::format("<level depth=\"{}\">", i));
+        }
+        writer.Append("<leaf>");
+        writer.AppendWords(4);
+        writer.Append("</leaf>");
+        for (size_t i{}; i < depth; ++i)
+        {
+          writer.Append("</level>");
+        }
+        writer.Append("\n");
+      }
+    }
+
+    void GenerateWideFanout(CorpusWriter& writer)
+    {
+      for (size_t id{}; !writer.IsFull(); ++id)
+      {
+        if (writer.Next() % 2 == 0)
+        {
+          writer.Append(std::format("<item id=\"{}\"/>\n", id));
+        }
+        else
+        {
+          writer.Append(std::format("<item id=\"{}\">{}</item>\n", id, WORDS[writer.Next() % WORDS.size()]));
+        }
+      }
+    }
+
+    void GenerateAttributeHeavy(CorpusWriter& writer)
+    {
+      for (size_t id{}; !writer.IsFull(); ++id)
+      {
+        writer.Append(std::format("<record id=\"{}\"", id));
+        size_t const nrOfAttributes = writer.Between(8, 24);
+        for (size_t i{}; i < nrOfAttributes; ++i)
+        {
+          writer.Append(std::format(" {}{}=\"{}\"", WORDS[i % WORDS.size()], i, writer.Next() % 100000));
+        }
+        writer.Append("/>\n");
+      }
+    }
+
+    void GenerateTextHeavy(CorpusWriter& writer)
+    {
+      for (size_t id{}; !writer.IsFull(); ++id)
+      {
+        writer.Append(std::format("<paragraph id=\"{}\">", id));
+        writer.AppendWords(writer.Between(64, 640), true);
+        writer.Append("</paragraph>\n");
+      }
+    }
+
+    void GenerateCommentHeavy(CorpusWriter& writer)
+    {
+      for (size_t id{}; !writer.IsFull(); ++id)
+      {
+        writer.Append("<!-- ");
+        writer.AppendWords(writer.Between(16, 96));
+        writer.Append(" -->\n");
+        writer.Append(std::format("<entry id=\"{}\"/>\n", id));
+      }
+    }
+
+    void GenerateMixed(CorpusWriter& writer)
+    {
+      constexpr std::array<std::string_view, 4> TYPES = {"book", "album", "film", "game"};
+
+      for (size_t id{}; !writer.IsFull(); ++id)
+      {
+        writer.Append(std::format("<record id=\"{}\" type=\"{}\">\n", id, TYPES[writer.Next() % TYPES.size()]));
+
+        writer.Append("  <name>");
+        writer.AppendWords(writer.Between(1, 4));
+        writer.Append("</name>\n");
+
+        writer.Append("  <tags>");
+        size_t const nrOfTags = writer.Between(0, 6);
+        for (size_t i{}; i < nrOfTags; ++i)
+        {
+          writer.Append(std::format("<tag>{}</tag>", WORDS[writer.Next() % WORDS.size()]));
+        }
+        writer.Append("</tags>\n");
+
+        size_t const cents = writer.Between(0, 99);
+        writer.Append(std::format("  <price currency=\"EUR\">{}.{}{}</price>\n", writer.Between(1, 999), cents / 10, cents % 10));
+
+        if (writer.Next() % 4 == 0)
+        {
+          writer.Append("  <!-- ");
+          writer.AppendWords(writer.Between(4, 16));
+          writer.Append(" -->\n");
+        }
+
+        writer.Append("  <description>");
+        writer.AppendWords(writer.Between(8, 64), true);
+        writer.Append("</description>\n");
+
+        writer.Append("</record>\n");
+      }
+    }
+  }  // namespace
+
+  std::string_view GetCorpusName(CorpusKind kind)
+  {
+    switch (kind)
+    {
+      case CorpusKind::DEEP_NESTING:
+        return "DeepNesting";
+      case CorpusKind::WIDE_FANOUT:
+        return "WideFanout";
+      case CorpusKind::ATTRIBUTE_HEAVY:
+        return "AttributeHeavy";
+      case CorpusKind::TEXT_HEAVY:
+        return "TextHeavy";
+      case CorpusKind::COMMENT_HEAVY:
+        return "CommentHeavy";
+      case CorpusKind::MIXED:
+        return "Mixed";
+    }
+
+    return "Unknown";
+  }
+
+  std::string GenerateCorpus(CorpusKind kind, size_t targetSize, uint64_t seed)
+  {
+    CorpusWriter writer{targetSize, seed};
+
+    writer.Append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    writer.Append(std::format("<corpus kind=\"{}\">\n", GetCorpusName(kind)));
+
+    switch (kind)
+    {
+      case CorpusKind::DEEP_NESTING:
+        GenerateDeepNesting(writer);
+        break;
+      case CorpusKind::WIDE_FANOUT:
+        GenerateWideFanout(writer);
+        break;
+      case CorpusKind::ATTRIBUTE_HEAVY:
+        GenerateAttributeHeavy(writer);
+        break;
+      case CorpusKind::TEXT_HEAVY:
+        GenerateTextHeavy(writer);
+        break;
+      case CorpusKind::COMMENT_HEAVY:
+        GenerateCommentHeavy(writer);
+        break;
+      case CorpusKind::MIXED:
+        GenerateMixed(writer);
+        break;
+    }
+
+    writer.Append("</corpus>\n");
+
+    return writer.Finish();
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace fxml
+{
+  // Shapes of synthetic documents, each one stresses a different part of the parser
+  enum class CorpusKind
+  {
+    DEEP_NESTING,     // Long chains of nested elements, every end tag has to be matched against a deep stack
+    WIDE_FANOUT,      // Hundreds of thousands of siblings under a single parent
+    ATTRIBUTE_HEAVY,  // Few children, many attributes per start tag
+    TEXT_HEAVY,       // Long text nodes with the occasional entity reference
+    COMMENT_HEAVY,    // More comment bytes than element bytes
+    MIXED,            // Record-like data mixing all of the above, used for the large documents
+  };
+
+  std::string_view GetCorpusName(CorpusKind kind);
+
+  /*
+  Generates a well-formed document of at least 'targetSize' bytes
+  The output only depends on 'kind', 'targetSize' and 'seed', the generator does not use the standard distributions since
+  their results differ between standard libraries
+  */
+  std::string GenerateCorpus(CorpusKind kind, size_t targetSize, uint64_t seed = 0x5EED);
+}  // namespace fxml
\ No newline at end of file
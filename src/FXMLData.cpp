@@ -1,11 +1,187 @@
 #include "FXMLData.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "FXMLScanner.h"
+#include "FXMLUtils.h"
+
 namespace fxml
 {
-  XMLElement::XMLElement(XMLTag const&& tag)
-    : m_tag(std::move(tag))
-    , m_children()
+  namespace
+  {
+    constexpr size_t MIN_NAME_SLOTS = 64;
+  }
+
+  XMLNameTable::XMLNameTable(std::pmr::memory_resource* resource)
+    : m_text(resource)
+    , m_offsets(1, 0, resource)
+    , m_slots(resource)
+  {
+  }
+
+  XMLNameTable::XMLNameTable(XMLNameTable const& other, std::pmr::memory_resource* resource)
+    : m_text(other.m_text, resource)
+    , m_offsets(other.m_offsets, resource)
+    , m_slots(other.m_slots, resource)
+  {
+  }
+
+  uint32_t XMLNameTable::Intern(std::string_view name)
+  {
+    // Kept at most half full, so a probe sequence stays short
+    if ((size() + 1) * 2 > m_slots.size())
+    {
+      Rehash(std::max(m_slots.size() * 2, MIN_NAME_SLOTS));
+    }
+
+    size_t const mask = m_slots.size() - 1;
+    for (size_t slot = std::hash<std::string_view>{}(name) & mask;; slot = (slot + 1) & mask)
+    {
+      uint32_t& id = m_slots[slot];
+      if (id == INVALID_ID)
+      {
+        id = static_cast<uint32_t>(size());
+        if (m_offsets.empty())
+        {
+          m_offsets.push_back(0);
+        }
+        m_text.append(name);
+        m_offsets.push_back(static_cast<uint32_t>(m_text.size()));
+        return id;
+      }
+
+      if (GetName(id) == name)
+      {
+        return id;
+      }
+    }
+  }
+
+  uint32_t XMLNameTable::Find(std::string_view name) const
+  {
+    if (m_slots.empty())
+    {
+      return INVALID_ID;
+    }
+
+    size_t const mask = m_slots.size() - 1;
+    for (size_t slot = std::hash<std::string_view>{}(name) & mask;; slot = (slot + 1) & mask)
+    {
+      uint32_t const id = m_slots[slot];
+      if (id == INVALID_ID || GetName(id) == name)
+      {
+        return id;
+      }
+    }
+  }
+
+  std::string_view XMLNameTable::GetName(uint32_t id) const
+  {
+    if (id >= size())
+    {
+      return {};
+    }
+
+    return std::string_view{m_text}.substr(m_offsets[id], m_offsets[id + 1] - m_offsets[id]);
+  }
+
+  size_t XMLNameTable::size() const
+  {
+    // A moved-from table has no offsets at all
+    return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+  }
+
+  bool XMLNameTable::empty() const
+  {
+    return size() == 0;
+  }
+
+  void XMLNameTable::clear()
+  {
+    m_text.clear();
+    m_offsets.assign(1, 0);
+    std::fill(m_slots.begin(), m_slots.end(), INVALID_ID);
+  }
+
+  void XMLNameTable::Rehash(size_t nrOfSlots)
+  {
+    std::pmr::vector<uint32_t> slots(nrOfSlots, INVALID_ID, m_slots.get_allocator());
+
+    size_t const mask = nrOfSlots - 1;
+    for (uint32_t id{}; id < size(); ++id)
+    {
+      size_t slot = std::hash<std::string_view>{}(GetName(id)) & mask;
+      while (slots[slot] != INVALID_ID)
+      {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = id;
+    }
+
+    m_slots = std::move(slots);
+  }
+
+  XMLAttributes::XMLAttributes(std::span<XMLAttribute const> attributes)
+    : m_attributes(attributes)
+  {
+  }
+
+  bool XMLAttributes::contains(std::string_view key) const
+  {
+    return find(key).has_value();
+  }
+
+  std::string_view XMLAttributes::at(std::string_view key) const
+  {
+    if (std::optional<std::string_view> const value = find(key); value.has_value())
+    {
+      return *value;
+    }
+
+    throw std::out_of_range("XMLAttributes::at: key not found");
+  }
+
+  std::optional<std::string_view> XMLAttributes::find(std::string_view key) const
+  {
+    // Elements rarely have more than a handful of attributes, a linear scan over contiguous memory beats any tree
+    for (XMLAttribute const& attribute : m_attributes)
+    {
+      if (attribute.key == key)
+      {
+        return attribute.value;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  size_t XMLAttributes::size() const
+  {
+    return m_attributes.size();
+  }
+
+  bool XMLAttributes::empty() const
+  {
+    return m_attributes.empty();
+  }
+
+  std::span<XMLAttribute const>::iterator XMLAttributes::begin() const
+  {
+    return m_attributes.begin();
+  }
+
+  std::span<XMLAttribute const>::iterator XMLAttributes::end() const
+  {
+    return m_attributes.end();
+  }
+
+  XMLElement::XMLElement(std::string_view name, uint32_t attributeOffset, uint32_t attributeCount)
+    : m_tag{name, {}}
     , m_rawContent()
+    , m_attributeOffset(attributeOffset)
+    , m_attributeCount(attributeCount)
   {
   }
 
@@ -24,23 +200,316 @@ namespace fxml
     return m_rawContent;
   }
 
-  void XMLDocument::AddXMLElement(XMLElement const&& element, bool front)
+  uint32_t XMLElement::GetNameId() const
+  {
+    return m_nameId;
+  }
+
+  XMLSiblingIterator::XMLSiblingIterator(std::span<XMLElement const> elements, uint32_t index)
+    : m_elements(elements)
+    , m_index(index)
+  {
+  }
+
+  XMLElement const& XMLSiblingIterator::operator*() const
+  {
+    return m_elements[m_index];
+  }
+
+  XMLElement const* XMLSiblingIterator::operator->() const
+  {
+    return &m_elements[m_index];
+  }
+
+  XMLSiblingIterator& XMLSiblingIterator::operator++()
+  {
+    m_index = m_elements[m_index].m_nextSibling;
+    return *this;
+  }
+
+  XMLSiblingIterator XMLSiblingIterator::operator++(int)
+  {
+    XMLSiblingIterator const copy{*this};
+    ++(*this);
+    return copy;
+  }
+
+  bool XMLSiblingIterator::operator==(XMLSiblingIterator const& other) const
   {
-    if (front)
+    return m_index == other.m_index;
+  }
+
+  XMLSiblingIterator XMLSiblingRange::begin() const
+  {
+    return first;
+  }
+
+  XMLSiblingIterator XMLSiblingRange::end() const
+  {
+    return XMLSiblingIterator{};
+  }
+
+  XMLIndexIterator::XMLIndexIterator(std::span<XMLElement const> elements, uint32_t const* index)
+    : m_elements(elements)
+    , m_index(index)
+  {
+  }
+
+  XMLElement const& XMLIndexIterator::operator*() const
+  {
+    return m_elements[*m_index];
+  }
+
+  XMLElement const* XMLIndexIterator::operator->() const
+  {
+    return &m_elements[*m_index];
+  }
+
+  XMLIndexIterator& XMLIndexIterator::operator++()
+  {
+    ++m_index;
+    return *this;
+  }
+
+  XMLIndexIterator XMLIndexIterator::operator++(int)
+  {
+    XMLIndexIterator const copy{*this};
+    ++(*this);
+    return copy;
+  }
+
+  bool XMLIndexIterator::operator==(XMLIndexIterator const& other) const
+  {
+    return m_index == other.m_index;
+  }
+
+  XMLIndexRange::XMLIndexRange(std::span<XMLElement const> elements, std::span<uint32_t const> indices)
+    : m_elements(elements)
+    , m_indices(indices)
+  {
+  }
+
+  XMLIndexIterator XMLIndexRange::begin() const
+  {
+    return XMLIndexIterator{m_elements, m_indices.data()};
+  }
+
+  XMLIndexIterator XMLIndexRange::end() const
+  {
+    return XMLIndexIterator{m_elements, m_indices.data() + m_indices.size()};
+  }
+
+  size_t XMLIndexRange::size() const
+  {
+    return m_indices.size();
+  }
+
+  bool XMLIndexRange::empty() const
+  {
+    return m_indices.empty();
+  }
+
+  size_t XMLDocument::AttributeHash::operator()(std::pair<std::string_view, std::string_view> const& attribute) const
+  {
+    size_t const keyHash = std::hash<std::string_view>{}(attribute.first);
+    size_t const valueHash = std::hash<std::string_view>{}(attribute.second);
+    return keyHash ^ (valueHash + 0x9e3779b97f4a7c15ull + (keyHash << 6) + (keyHash >> 2));
+  }
+
+  size_t XMLDocument::DecodeKeyHash::operator()(DecodeKey const& key) const
+  {
+    size_t const dataHash = std::hash<char const*>{}(key.first);
+    return dataHash ^ (key.second + 0x9e3779b97f4a7c15ull + (dataHash << 6) + (dataHash >> 2));
+  }
+
+  XMLSource::XMLSource(char const* data, size_t size, ReleaseFunction release)
+    : m_data(data)
+    , m_size(size)
+    , m_release(std::move(release))
+  {
+  }
+
+  XMLSource::~XMLSource()
+  {
+    if (m_release)
     {
-      m_elements.insert(m_elements.begin(), std::move(element));
+      m_release(m_data, m_size);
     }
-    else
+  }
+
+  XMLSource::XMLSource(XMLSource&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_release(std::exchange(other.m_release, nullptr))
+  {
+  }
+
+  XMLSource& XMLSource::operator=(XMLSource&& other) noexcept
+  {
+    if (this != &other)
     {
-      m_elements.push_back(std::move(element));
+      if (m_release)
+      {
+        m_release(m_data, m_size);
+      }
+
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_release = std::exchange(other.m_release, nullptr);
+    }
+
+    return *this;
+  }
+
+  std::string_view XMLSource::GetText() const
+  {
+    return std::string_view{m_data, m_size};
+  }
+
+  XMLDocument::DecodeCache::DecodeCache(std::pmr::memory_resource* resource)
+    : values(resource)
+  {
+  }
+
+  void XMLDocument::DecodeCacheDeleter::operator()(DecodeCache* cache) const
+  {
+    std::pmr::polymorphic_allocator<DecodeCache>{resource}.delete_object(cache);
+  }
+
+  XMLDocument::XMLDocument(std::pmr::vector<XMLElement>&& elements, std::pmr::vector<XMLAttribute>&& attributes)
+    : XMLDocument(std::move(elements), std::move(attributes), XMLNameTable{elements.get_allocator().resource()})
+  {
+    InternNames(m_elements, m_attributes);
+  }
+
+  XMLDocument::XMLDocument(std::pmr::vector<XMLElement>&& elements, std::pmr::vector<XMLAttribute>&& attributes, XMLNameTable&& names)
+    : m_elements(std::move(elements))
+    , m_attributes(std::move(attributes))
+    , m_names(std::move(names))
+  {
+    std::pmr::memory_resource* const resource = m_elements.get_allocator().resource();
+    m_decodeCache = std::unique_ptr<DecodeCache, DecodeCacheDeleter>{
+        std::pmr::polymorphic_allocator<DecodeCache>{resource}.new_object<DecodeCache>(resource), DecodeCacheDeleter{resource}};
+
+    BindAttributes();
+  }
+
+  XMLDocument& XMLDocument::operator=(XMLDocument&& other)
+  {
+    if (this != &other)
+    {
+      XMLAttribute const* const attributes = other.m_attributes.data();
+
+      m_elements = std::move(other.m_elements);
+      m_attributes = std::move(other.m_attributes);
+      m_names = std::move(other.m_names);
+      m_index = std::move(other.m_index);
+      m_decodeCache = std::move(other.m_decodeCache);
+      m_source = std::move(other.m_source);
+      m_filtered = other.m_filtered;
+
+      // Arrays from a different memory resource are moved element by element, the views still point at the old array then
+      if (m_attributes.data() != attributes)
+      {
+        BindAttributes();
+      }
+    }
+
+    return *this;
+  }
+
+  XMLDocument XMLDocument::Clone() const
+  {
+    std::pmr::memory_resource* const resource = m_elements.get_allocator().resource();
+
+    XMLDocument clone{std::pmr::vector<XMLElement>{m_elements, resource}, std::pmr::vector<XMLAttribute>{m_attributes, resource},
+                      XMLNameTable{m_names, resource}};
+    clone.m_filtered = m_filtered;
+
+    std::string_view const text = m_source.GetText();
+    if (text.empty())
+    {
+      return clone;
+    }
+
+    char* const data = static_cast<char*>(resource->allocate(text.size(), 1));
+    std::copy(text.begin(), text.end(), data);
+    clone.m_source = XMLSource{data, text.size(), [resource](char const* p, size_t size) { resource->deallocate(const_cast<char*>(p), size, 1); }};
+
+    // Every view into the old source moves along to the same spot in the new one
+    auto const rebase = [text, data](std::string_view& view)
+    {
+      if (view.data() >= text.data() && view.data() < text.data() + text.size())
+      {
+        view = std::string_view{data + (view.data() - text.data()), view.size()};
+      }
+    };
+    for (XMLElement& element : clone.m_elements)
+    {
+      rebase(element.m_tag.name);
+      rebase(element.m_rawContent);
+    }
+    for (XMLAttribute& attribute : clone.m_attributes)
+    {
+      rebase(attribute.key);
+      rebase(attribute.value);
+    }
+
+    return clone;
+  }
+
+  void XMLDocument::BindAttributes()
+  {
+    std::span<XMLAttribute const> const attributes{m_attributes};
+    for (XMLElement& element : m_elements)
+    {
+      element.m_tag.attributes = XMLAttributes{attributes.subspan(element.m_attributeOffset, element.m_attributeCount)};
+    }
+  }
+
+  void XMLDocument::InternNames(std::span<XMLElement> elements, std::span<XMLAttribute const> attributes)
+  {
+    for (XMLElement& element : elements)
+    {
+      element.m_nameId = m_names.Intern(element.m_tag.name);
+    }
+    for (XMLAttribute const& attribute : attributes)
+    {
+      m_names.Intern(attribute.key);
     }
   }
 
   std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetNodeByName(std::string_view tagName)
   {
+    return std::as_const(*this).GetNodeByName(GetNameId(tagName));
+  }
+
+  XMLNameTable const& XMLDocument::GetNames() const
+  {
+    return m_names;
+  }
+
+  uint32_t XMLDocument::GetNameId(std::string_view name) const
+  {
+    return m_names.Find(name);
+  }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetNodeByName(uint32_t nameId) const
+  {
+    if (nameId == XMLNameTable::INVALID_ID)
+    {
+      return std::nullopt;
+    }
+
+    if (m_index)
+    {
+      XMLIndexRange const nodes = GetNodesByName(nameId);
+      return nodes.empty() ? std::nullopt : std::optional<std::reference_wrapper<XMLElement const>>{*nodes.begin()};
+    }
+
     for (XMLElement const& element : m_elements)
     {
-      if (element.GetTag().name == tagName)
+      if (element.m_nameId == nameId)
       {
         return element;
       }
@@ -49,6 +518,58 @@ namespace fxml
     return std::nullopt;
   }
 
+  std::string_view XMLDocument::Decode(std::string_view raw) const
+  {
+    // The common case, nothing to decode and nothing to copy
+    if (!m_decodeCache || FindFirstOf(raw, detail::REFERENCE_START_CHARS) == std::string_view::npos)
+    {
+      return raw;
+    }
+
+    std::lock_guard const lock{m_decodeCache->mutex};
+    auto const [it, inserted] = m_decodeCache->values.try_emplace(DecodeKey{raw.data(), raw.size()});
+    if (inserted)
+    {
+      it->second.reserve(raw.size());
+      detail::DecodeReferences(raw, it->second);
+    }
+
+    return it->second;
+  }
+
+  std::string_view XMLDocument::GetContent(XMLElement const& element) const
+  {
+    // Text from a CDATA section is literal
+    std::string_view const raw = element.GetRawContent();
+    if (detail::IsCDataText(raw))
+    {
+      return raw;
+    }
+
+    return Decode(raw);
+  }
+
+  std::optional<std::string_view> XMLDocument::GetAttributeValue(XMLElement const& element, std::string_view key) const
+  {
+    std::optional<std::string_view> const value = element.GetTag().attributes.find(key);
+    if (!value.has_value())
+    {
+      return std::nullopt;
+    }
+
+    return Decode(*value);
+  }
+
+  std::optional<std::string_view> XMLDocument::GetAttributeValue(XMLElement const& element, uint32_t keyId) const
+  {
+    if (keyId >= m_names.size())
+    {
+      return std::nullopt;
+    }
+
+    return GetAttributeValue(element, m_names.GetName(keyId));
+  }
+
   std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetNodeByIndex(uint32_t index) const
   {
     if (index >= m_elements.size())
@@ -59,8 +580,130 @@ namespace fxml
     return m_elements[index];
   }
 
+  XMLIndexRange XMLDocument::GetNodesByName(std::string_view tagName) const
+  {
+    return GetNodesByName(GetNameId(tagName));
+  }
+
+  XMLIndexRange XMLDocument::GetNodesByName(uint32_t nameId) const
+  {
+    BuildIndex();
+
+    // Attribute keys have IDs as well, those have an empty range
+    if (nameId >= m_index->names.size())
+    {
+      return XMLIndexRange{};
+    }
+
+    IndexRange const range = m_index->names[nameId];
+    return XMLIndexRange{m_elements, std::span<uint32_t const>{m_index->nameEntries}.subspan(range.offset, range.count)};
+  }
+
+  XMLIndexRange XMLDocument::GetNodesByAttribute(std::string_view key, std::string_view value) const
+  {
+    BuildIndex();
+
+    auto const it = m_index->attributes.find({key, value});
+    if (it == m_index->attributes.end())
+    {
+      return XMLIndexRange{};
+    }
+
+    return XMLIndexRange{m_elements, std::span<uint32_t const>{m_index->attributeEntries}.subspan(it->second.offset, it->second.count)};
+  }
+
+  void XMLDocument::BuildIndex() const
+  {
+    if (m_index)
+    {
+      return;
+    }
+
+    auto index = std::make_unique<Index>();
+
+    // Counting sort: count every group, turn the counts into offsets, then scatter the element indices in document order
+    // Names are grouped on their ID, which needs no hashing at all
+    index->names.resize(m_names.size());
+    for (XMLElement const& element : m_elements)
+    {
+      ++index->names[element.m_nameId].count;
+    }
+    for (XMLAttribute const& attribute : m_attributes)
+    {
+      ++index->attributes[{attribute.key, attribute.value}].count;
+    }
+
+    uint32_t offset{};
+    for (IndexRange& range : index->names)
+    {
+      range.offset = offset;
+      offset += range.count;
+      range.count = 0;
+    }
+    offset = 0;
+    for (auto& [attribute, range] : index->attributes)
+    {
+      range.offset = offset;
+      offset += range.count;
+      range.count = 0;
+    }
+
+    index->nameEntries.resize(m_elements.size());
+    index->attributeEntries.resize(m_attributes.size());
+    for (uint32_t i{}; i < m_elements.size(); ++i)
+    {
+      XMLElement const& element = m_elements[i];
+
+      IndexRange& name = index->names[element.m_nameId];
+      index->nameEntries[name.offset + name.count++] = i;
+
+      for (XMLAttribute const& attribute : element.GetTag().attributes)
+      {
+        IndexRange& range = index->attributes[{attribute.key, attribute.value}];
+        index->attributeEntries[range.offset + range.count++] = i;
+      }
+    }
+
+    m_index = std::move(index);
+  }
+
+  bool XMLDocument::HasIndex() const
+  {
+    return m_index != nullptr;
+  }
+
   size_t XMLDocument::GetNrOfNodes() const
   {
     return m_elements.size();
   }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetRoot() const
+  {
+    return GetNodeByIndex(0);
+  }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetParent(XMLElement const& element) const
+  {
+    return GetNodeByIndex(element.m_parent);
+  }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetFirstChild(XMLElement const& element) const
+  {
+    return GetNodeByIndex(element.m_firstChild);
+  }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLDocument::GetNextSibling(XMLElement const& element) const
+  {
+    return GetNodeByIndex(element.m_nextSibling);
+  }
+
+  XMLSiblingRange XMLDocument::GetChildren(XMLElement const& element) const
+  {
+    return XMLSiblingRange{XMLSiblingIterator{m_elements, element.m_firstChild}};
+  }
+
+  uint32_t XMLDocument::GetIndex(XMLElement const& element) const
+  {
+    return static_cast<uint32_t>(&element - m_elements.data());
+  }
 }  // namespace fxml
\ No newline at end of file
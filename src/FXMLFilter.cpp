@@ -0,0 +1,209 @@
+#include "FXML.h"
+
+#include <format>
+#include <span>
+#include <vector>
+
+#include "FXMLData.h"
+#include "FXMLQuery.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  std::expected<void, XMLError> XMLParser::CompileFilter()
+  {
+    if (m_filterCompiled)
+    {
+      RETURN_OK();
+    }
+
+    m_filterPaths.clear();
+    for (std::string const& path : m_options.filter)
+    {
+      auto const query = XMLQuery::Compile(path);
+      if (!query)
+      {
+        return std::unexpected{query.error()};
+      }
+
+      // Predicates would need the attributes of every candidate, which is exactly what a filtered parse does not lex
+      std::vector<FilterStep> steps;
+      for (XMLQuery::Step const& step : query->GetSteps())
+      {
+        if (!step.attributes.empty() || step.position != 0)
+        {
+          return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, std::format("Filter path '{}' has a predicate, filters only match names", path)}};
+        }
+
+        steps.push_back(FilterStep{step.axis == XMLQuery::Axis::DESCENDANT, step.name});
+      }
+      m_filterPaths.push_back(std::move(steps));
+    }
+    m_filterCompiled = true;
+
+    RETURN_OK();
+  }
+
+  // Whether the last of 'steps' matches the last of 'names' and the steps in front of it match its ancestors
+  bool XMLParser::MatchesFilterPath(std::span<FilterStep const> steps, std::span<std::string_view const> names)
+  {
+    FilterStep const& step = steps.back();
+    if (step.name != "*" && step.name != names.back())
+    {
+      return false;
+    }
+
+    if (steps.size() == 1)
+    {
+      return step.descendant || names.size() == 1;
+    }
+
+    if (!step.descendant)
+    {
+      return names.size() > 1 && MatchesFilterPath(steps.first(steps.size() - 1), names.first(names.size() - 1));
+    }
+
+    for (size_t depth{names.size() - 1}; depth > 0; --depth)
+    {
+      if (MatchesFilterPath(steps.first(steps.size() - 1), names.first(depth)))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool XMLParser::MatchesFilter() const
+  {
+    for (std::vector<FilterStep> const& steps : m_filterPaths)
+    {
+      if (MatchesFilterPath(steps, m_skippedElementStack))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::expected<XMLDocument, XMLError> XMLParser::ParseBufferFiltered(std::string_view buffer)
+  {
+    using namespace detail;
+
+    CHECK_EXPECTED_VOID(CompileFilter());
+
+    Reset();
+
+    {
+      FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+
+      // Only the names of the open elements are kept, which is all a path needs. Attributes and text are never looked at
+      size_t pos{};
+      while (true)
+      {
+        size_t const open = buffer.find('<', pos);
+        if (open == std::string_view::npos)
+        {
+          break;
+        }
+
+        CHECK_EXPECTED(char, kind, SafeAccess(buffer, open + 1), "Could not find closing bracket of start tag");
+
+        // A '<' inside a comment or CDATA section does not open anything
+        if (kind == '!')
+        {
+          if (buffer.substr(open, CDATA_START.size()) == CDATA_START)
+          {
+            CHECK_EXPECTED(size_t, end, SafeFind(buffer, CDATA_END, open + CDATA_START.size()), "CDATA section is not closed");
+            pos = end + CDATA_END.size();
+          }
+          else
+          {
+            CHECK_EXPECTED(size_t, end, SafeFind(buffer, "-->", open + 1), "Comment is not closed");
+            pos = end + 3;
+          }
+          continue;
+        }
+
+        if (kind == '?')
+        {
+          CHECK_EXPECTED(size_t, end, SafeFind(buffer, "?>", open + 2), "Processing instruction is not closed");
+          pos = end + 2;
+          continue;
+        }
+
+        CHECK_EXPECTED(size_t, close, SafeFindTagEnd(buffer, open + 1), "Could not find closing bracket of tag");
+        pos = close + 1;
+
+        if (kind == '/')
+        {
+          std::string_view const name = TrimTrailingWhitespace(buffer.substr(open + 2, close - open - 2));
+          if (m_skippedElementStack.empty())
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag reached while no start tag was parsed"}};
+          }
+          if (m_skippedElementStack.back() != name)
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+          }
+
+          m_skippedElementStack.pop_back();
+          continue;
+        }
+
+        std::string_view const rawTag = buffer.substr(open, close - open + 1);
+        std::string_view const name = rawTag.substr(1, FindFirstChar(rawTag, NAME_END_CHARS).first - 1);
+        if (name.empty())
+        {
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Start tag is malformed"}};
+        }
+
+        m_skippedElementStack.push_back(name);
+        if (MatchesFilter())
+        {
+          // The whole subtree goes through the tokenizer, with nothing open it becomes a top-level element of the document
+          Tokenizer tokenizer{*this};
+          m_bufferPointer = open;
+          do
+          {
+            CHECK_EXPECTED_NO_TRANSFORM(bool, parsed, tokenizer.ParseToken(buffer, m_bufferPointer));
+            if (!parsed)
+            {
+              return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open",
+                                                                                    m_elements[m_elementStack.back().index].GetTag().name)}};
+            }
+          } while (!m_elementStack.empty());
+
+          m_skippedElementStack.pop_back();
+          pos = m_bufferPointer;
+        }
+        else if (rawTag[rawTag.size() - 2] == '/')
+        {
+          m_skippedElementStack.pop_back();
+        }
+      }
+
+      m_bufferPointer = buffer.size();
+    }
+    FXML_INSTRUMENT(m_stats.bytesScanned = m_bufferPointer);
+
+    if (!m_skippedElementStack.empty())
+    {
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", m_skippedElementStack.back())}};
+    }
+
+    FXML_INSTRUMENT(CollectStats(m_elements, m_attributes));
+    FXML_INSTRUMENT(ScopedTimer const buildTimer{m_stats.buildTime});
+
+    XMLDocument doc{std::move(m_elements), std::move(m_attributes), std::move(m_names)};
+    doc.m_filtered = true;
+    if (m_options.buildIndex)
+    {
+      doc.BuildIndex();
+    }
+
+    return doc;
+  }
+}  // namespace fxml
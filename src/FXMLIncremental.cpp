@@ -0,0 +1,343 @@
+#include "FXML.h"
+
+#include <algorithm>
+#include <format>
+#include <vector>
+
+#include "FXMLData.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  /*
+  Parses either the content of one element, from right behind its start tag up to and including its end tag, or one whole element
+  Indices are local to the subtree, the elements without a parent are the children of the element or the element itself
+  */
+  class XMLParser::SubtreeBuilder
+  {
+   public:
+    std::string_view name;  // Of the element whose content gets parsed, empty when parsing a whole element
+    std::vector<XMLElement> elements;
+    std::vector<XMLAttribute> attributes;
+    std::vector<OpenElement> openElements;
+    uint32_t lastTopLevel = XMLElement::INVALID_INDEX;
+    std::string_view content;
+    size_t end = 0;                // Behind the last token
+    char const* endTag = nullptr;  // The '<' of the end tag of the element whose content gets parsed
+    bool done = false;
+
+    explicit SubtreeBuilder(std::string_view elementName)
+      : name(elementName)
+    {
+    }
+
+    std::expected<void, XMLError> Parse(std::string_view buffer, size_t start)
+    {
+      Tokenizer tokenizer{*this};
+      size_t bufferPointer{start};
+      while (!done)
+      {
+        CHECK_EXPECTED_NO_TRANSFORM(bool, parsed, tokenizer.ParseToken(buffer, bufferPointer));
+        if (!parsed)
+        {
+          std::string_view const openName = openElements.empty() ? name : elements[openElements.back().index].GetTag().name;
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", openName)}};
+        }
+      }
+      end = bufferPointer;
+
+      RETURN_OK();
+    }
+
+    // ==============================
+    // ====== TOKENIZER EVENTS ======
+    // ==============================
+    std::vector<XMLAttribute>& GetAttributeStorage()
+    {
+      return attributes;
+    }
+
+    // Either the element whose content gets parsed is open, or parsing starts at a start tag
+    bool HasOpenElement() const
+    {
+      return true;
+    }
+
+    std::expected<void, XMLError> OnStartTag(std::string_view tagName, std::span<XMLAttribute const> tagAttributes, bool isEmptyElement)
+    {
+      uint32_t const index = static_cast<uint32_t>(elements.size());
+      XMLElement element{tagName, static_cast<uint32_t>(attributes.size() - tagAttributes.size()), static_cast<uint32_t>(tagAttributes.size())};
+
+      uint32_t& previousSibling = openElements.empty() ? lastTopLevel : openElements.back().lastChild;
+      if (!openElements.empty())
+      {
+        element.m_parent = openElements.back().index;
+        if (previousSibling == XMLElement::INVALID_INDEX)
+        {
+          elements[element.m_parent].m_firstChild = index;
+        }
+      }
+      if (previousSibling != XMLElement::INVALID_INDEX)
+      {
+        elements[previousSibling].m_nextSibling = index;
+      }
+      previousSibling = index;
+
+      elements.push_back(element);
+
+      if (!isEmptyElement)
+      {
+        openElements.push_back(OpenElement{index, XMLElement::INVALID_INDEX});
+      }
+      else if (openElements.empty() && name.empty())
+      {
+        done = true;
+      }
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnEndTag(std::string_view tagName)
+    {
+      std::string_view const openName = openElements.empty() ? name : elements[openElements.back().index].GetTag().name;
+      if (openName != tagName)
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", tagName)}};
+      }
+
+      if (openElements.empty())
+      {
+        endTag = tagName.data() - 2;  // '</'
+      }
+      else
+      {
+        openElements.pop_back();
+      }
+      done = openElements.empty();
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnContent(std::string_view text)
+    {
+      if (openElements.empty())
+      {
+        content = text;
+      }
+      else
+      {
+        elements[openElements.back().index].SetRawContent(text);
+      }
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnComment(std::string_view)
+    {
+      RETURN_OK();
+    }
+  };
+
+  std::expected<void, XMLError> XMLParser::Reparse(XMLDocument& document, XMLEdit const& edit)
+  {
+    if (document.m_source.GetText().empty() && document.GetNrOfNodes() > 0)
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Document does not own its text, pass the text it was parsed from"}};
+    }
+
+    return Reparse(document, document.m_source.GetText(), edit);
+  }
+
+  std::expected<void, XMLError> XMLParser::Reparse(XMLDocument& document, std::string_view const oldText, XMLEdit const& edit)
+  {
+    using namespace detail;
+
+    FXML_INSTRUMENT(m_stats = XMLParseStats{});
+
+    // Whatever parser built it, a filtered document has no full node array to splice a subtree into
+    if (document.m_filtered)
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Documents of a filtered parse cannot be re-parsed"}};
+    }
+    // An edit outside of every element parses the whole text again, which would leave a filtered document behind
+    if (!m_options.filter.empty())
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Filtered parsers cannot re-parse documents"}};
+    }
+    if (document.GetNrOfNodes() > 0)
+    {
+      char const* const name = document.m_elements.front().m_tag.name.data();
+      if (name < oldText.data() || name >= oldText.data() + oldText.size())
+      {
+        return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Document was not parsed from the given text"}};
+      }
+    }
+    if (edit.offset > oldText.size() || edit.length > oldText.size() - edit.offset)
+    {
+      return std::unexpected{
+          XMLError{ErrorReason::INVALID_ARGUMENT, std::format("Edit at offset {} runs past the end of the {} byte text", edit.offset, oldText.size())}};
+    }
+
+    // The edited text goes into a new buffer, views in front of the edit keep their offset and views behind it move by 'delta'
+    size_t const editEnd = edit.offset + edit.length;
+    size_t const newSize = oldText.size() - edit.length + edit.replacement.size();
+    std::pmr::memory_resource* const resource = document.m_elements.get_allocator().resource();
+    char* const data = static_cast<char*>(resource->allocate(newSize, 1));
+    XMLSource source{data, newSize, [resource](char const* p, size_t size) { resource->deallocate(const_cast<char*>(p), size, 1); }};
+    std::copy_n(oldText.data(), edit.offset, data);
+    std::copy(edit.replacement.begin(), edit.replacement.end(), data + edit.offset);
+    std::copy(oldText.begin() + editEnd, oldText.end(), data + edit.offset + edit.replacement.size());
+    std::string_view const newText = source.GetText();
+    ptrdiff_t const delta = static_cast<ptrdiff_t>(edit.replacement.size()) - static_cast<ptrdiff_t>(edit.length);
+
+    std::pmr::vector<XMLElement>& elements = document.m_elements;
+    auto const startOf = [&oldText](XMLElement const& element) { return static_cast<size_t>(element.m_tag.name.data() - 1 - oldText.data()); };
+
+    // The element which encloses the edit is the last one that starts in front of it, or one of its ancestors
+    // An edit within its start tag parses that element as a whole, one behind the start tag only parses its content
+    auto const next = std::partition_point(elements.begin(), elements.end(), [&](XMLElement const& element) { return startOf(element) < edit.offset; });
+    uint32_t candidate = next == elements.begin() ? XMLElement::INVALID_INDEX : static_cast<uint32_t>(next - elements.begin() - 1);
+    for (; candidate != XMLElement::INVALID_INDEX; candidate = elements[candidate].m_parent)
+    {
+      XMLElement const& enclosing = elements[candidate];
+      size_t const startTagEnd = SafeFindTagEnd(oldText, startOf(enclosing)).value_or(std::string_view::npos);
+      bool const wholeElement = startTagEnd == std::string_view::npos || startTagEnd >= edit.offset;
+      if (!wholeElement && oldText[startTagEnd - 1] == '/')
+      {
+        continue;
+      }
+
+      // Everything up to here is the same as in a full parse, so an error here is one the full parse runs into as well
+      SubtreeBuilder builder{wholeElement ? std::string_view{} : enclosing.m_tag.name};
+      size_t const start = wholeElement ? startOf(enclosing) : startTagEnd + 1;
+      {
+        FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+        CHECK_EXPECTED_VOID(builder.Parse(newText, start));
+      }
+      FXML_INSTRUMENT(m_stats.bytesScanned += builder.end - start);
+
+      // Done in front of the end of the edit, so the edit is not within this element
+      size_t const end = wholeElement ? builder.end : static_cast<size_t>(builder.endTag - newText.data());
+      if (end < edit.offset + edit.replacement.size())
+      {
+        continue;
+      }
+
+      // The text behind 'end' is the old text behind 'oldEnd', which only parses the same if the element ended right there before the edit
+      // as well. It may not have, e.g. when the edit opened a comment which some old comment closes
+      size_t const oldEnd = static_cast<size_t>(static_cast<ptrdiff_t>(end) - delta);
+      SubtreeBuilder oldBuilder{builder.name};
+      if (!oldBuilder.Parse(oldText, start).has_value() ||
+          (wholeElement ? oldBuilder.end : static_cast<size_t>(oldBuilder.endTag - oldText.data())) != oldEnd)
+      {
+        continue;
+      }
+      FXML_INSTRUMENT(m_stats.bytesScanned += oldBuilder.end - start);
+
+      // The old subtree is every element which starts before the old end, its attributes are the ones in between
+      uint32_t const parent = wholeElement ? enclosing.m_parent : candidate;
+      uint32_t const first = wholeElement ? candidate : candidate + 1;
+      uint32_t const last = static_cast<uint32_t>(
+          std::partition_point(elements.begin() + first, elements.end(), [&](XMLElement const& element) { return startOf(element) < oldEnd; }) -
+          elements.begin());
+      uint32_t const attributeBegin = wholeElement ? enclosing.m_attributeOffset : enclosing.m_attributeOffset + enclosing.m_attributeCount;
+      uint32_t const attributeEnd = last < elements.size() ? elements[last].m_attributeOffset : static_cast<uint32_t>(document.m_attributes.size());
+      uint32_t const nextSibling = enclosing.m_nextSibling;
+
+      int64_t const elementDelta = static_cast<int64_t>(builder.elements.size()) - static_cast<int64_t>(last - first);
+      int64_t const attributeDelta = static_cast<int64_t>(builder.attributes.size()) - static_cast<int64_t>(attributeEnd - attributeBegin);
+
+      auto const rebase = [&](std::string_view& view)
+      {
+        if (view.data() >= oldText.data() && view.data() <= oldText.data() + oldText.size())
+        {
+          size_t const offset = static_cast<size_t>(view.data() - oldText.data());
+          view = std::string_view{data + (offset >= editEnd ? static_cast<size_t>(static_cast<ptrdiff_t>(offset) + delta) : offset), view.size()};
+        }
+      };
+      auto const shift = [&](uint32_t index)
+      {
+        return index != XMLElement::INVALID_INDEX && index >= last ? static_cast<uint32_t>(index + elementDelta) : index;
+      };
+      auto const local = [first](uint32_t index) { return index == XMLElement::INVALID_INDEX ? index : index + first; };
+
+      // Everything outside of the subtree stays, moved along in the text and the node arrays
+      for (uint32_t i{}; i < elements.size(); ++i)
+      {
+        if (i >= first && i < last)
+        {
+          continue;
+        }
+
+        XMLElement& element = elements[i];
+        rebase(element.m_tag.name);
+        rebase(element.m_rawContent);
+        element.m_parent = shift(element.m_parent);
+        element.m_firstChild = shift(element.m_firstChild);
+        element.m_nextSibling = shift(element.m_nextSibling);
+        if (i >= last)
+        {
+          element.m_attributeOffset = static_cast<uint32_t>(element.m_attributeOffset + attributeDelta);
+        }
+      }
+      for (uint32_t i{}; i < document.m_attributes.size(); ++i)
+      {
+        if (i < attributeBegin || i >= attributeEnd)
+        {
+          rebase(document.m_attributes[i].key);
+          rebase(document.m_attributes[i].value);
+        }
+      }
+
+      // The new subtree hangs where the old one did
+      for (XMLElement& element : builder.elements)
+      {
+        bool const isTopLevel = element.m_parent == XMLElement::INVALID_INDEX;
+        element.m_parent = isTopLevel ? parent : element.m_parent + first;
+        element.m_firstChild = local(element.m_firstChild);
+        element.m_nextSibling = isTopLevel && element.m_nextSibling == XMLElement::INVALID_INDEX && wholeElement ? shift(nextSibling)
+                                                                                                                : local(element.m_nextSibling);
+        element.m_attributeOffset += attributeBegin;
+      }
+      if (!wholeElement)
+      {
+        elements[candidate].m_firstChild = builder.elements.empty() ? XMLElement::INVALID_INDEX : first;
+        elements[candidate].m_rawContent = builder.content;
+      }
+
+      elements.erase(elements.begin() + first, elements.begin() + last);
+      elements.insert(elements.begin() + first, builder.elements.begin(), builder.elements.end());
+      document.m_attributes.erase(document.m_attributes.begin() + attributeBegin, document.m_attributes.begin() + attributeEnd);
+      document.m_attributes.insert(document.m_attributes.begin() + attributeBegin, builder.attributes.begin(), builder.attributes.end());
+
+      // Both are keyed on views into the old text
+      document.m_index.reset();
+      if (document.m_decodeCache)
+      {
+        std::lock_guard const lock{document.m_decodeCache->mutex};
+        document.m_decodeCache->values.clear();
+      }
+
+      // Names the document has seen before keep their ID
+      document.InternNames(std::span<XMLElement>{elements}.subspan(first, builder.elements.size()),
+                           std::span<XMLAttribute const>{document.m_attributes}.subspan(attributeBegin, builder.attributes.size()));
+      document.BindAttributes();
+      document.m_source = std::move(source);
+
+      FXML_INSTRUMENT(ReportStats());
+      RETURN_OK();
+    }
+
+    // No element encloses the edit, e.g. it changes the root's start tag
+    std::expected<XMLDocument, XMLError> reparsed = ParseBuffer(newText);
+    FXML_INSTRUMENT(ReportStats());
+    if (!reparsed.has_value())
+    {
+      return std::unexpected{reparsed.error()};
+    }
+
+    document = AttachSource(std::move(reparsed.value()), std::move(source));
+    RETURN_OK();
+  }
+}  // namespace fxml
\ No newline at end of file
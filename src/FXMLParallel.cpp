@@ -0,0 +1,373 @@
+#include "FXML.h"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "FXMLData.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  /*
+  Builds the part of the tree that lies in one chunk of the buffer, every index is local to the chunk
+  Whatever reaches past the start of the chunk is recorded as a boundary event, the fix-up pass resolves those in document order:
+
+    - an element opened while no element of this chunk is open, its parent and previous sibling live in an earlier chunk
+    - an end tag while no element of this chunk is open, it closes an element of an earlier chunk
+    - content while no element of this chunk is open, it belongs to an element of an earlier chunk
+  */
+  class XMLParser::ChunkBuilder
+  {
+   public:
+    enum class BoundaryType
+    {
+      TOP_LEVEL_ELEMENT = 0,
+      END_TAG = 1,
+      CONTENT = 2
+    };
+
+    struct BoundaryEvent
+    {
+      BoundaryType type;
+      uint32_t index;         // TOP_LEVEL_ELEMENT
+      std::string_view text;  // END_TAG name or CONTENT
+    };
+
+    size_t begin = 0;  // Where tokenizing started
+    size_t end = 0;    // Start of the first token that was left for the next chunk
+    std::vector<XMLElement> elements;
+    std::vector<XMLAttribute> attributes;
+    std::vector<OpenElement> openElements;
+    std::vector<BoundaryEvent> boundaryEvents;
+    std::optional<XMLError> error;
+
+#if FXML_ENABLE_INSTRUMENTATION
+    size_t nrOfComments = 0;
+    size_t nrOfTextNodes = 0;
+    size_t bytesScanned = 0;  // Not reset by Parse, a chunk that gets parsed again counts twice
+#endif
+
+    // Tokenizes every token which starts in [begin, limit), the last one may run past 'limit'
+    void Parse(std::string_view buffer, size_t const start, size_t const limit)
+    {
+      begin = start;
+      elements.clear();
+      attributes.clear();
+      openElements.clear();
+      boundaryEvents.clear();
+      error.reset();
+      FXML_INSTRUMENT(nrOfComments = 0);
+      FXML_INSTRUMENT(nrOfTextNodes = 0);
+
+      Tokenizer tokenizer{*this};
+      size_t bufferPointer{start};
+      while (true)
+      {
+        while (bufferPointer < limit && std::isspace(static_cast<unsigned char>(buffer[bufferPointer])))
+        {
+          ++bufferPointer;
+        }
+
+        if (bufferPointer >= limit)
+        {
+          break;
+        }
+
+        if (auto const ret = tokenizer.ParseToken(buffer, bufferPointer); !ret.has_value())
+        {
+          error = ret.error();
+          break;
+        }
+      }
+
+      end = bufferPointer;
+      FXML_INSTRUMENT(bytesScanned += end - begin);
+    }
+
+    // ==============================
+    // ====== TOKENIZER EVENTS ======
+    // ==============================
+    std::vector<XMLAttribute>& GetAttributeStorage()
+    {
+      return attributes;
+    }
+
+    // Elements of earlier chunks may still be open, that is only known once the fix-up pass gets here
+    bool HasOpenElement() const
+    {
+      return true;
+    }
+
+    std::expected<void, XMLError> OnStartTag(std::string_view name, std::span<XMLAttribute const> tagAttributes, bool isEmptyElement)
+    {
+      uint32_t const index = static_cast<uint32_t>(elements.size());
+      XMLElement element{name, static_cast<uint32_t>(attributes.size() - tagAttributes.size()), static_cast<uint32_t>(tagAttributes.size())};
+
+      if (openElements.empty())
+      {
+        boundaryEvents.push_back(BoundaryEvent{BoundaryType::TOP_LEVEL_ELEMENT, index, {}});
+      }
+      else
+      {
+        OpenElement& parent = openElements.back();
+        element.m_parent = parent.index;
+        if (parent.lastChild == XMLElement::INVALID_INDEX)
+        {
+          elements[parent.index].m_firstChild = index;
+        }
+        else
+        {
+          elements[parent.lastChild].m_nextSibling = index;
+        }
+        parent.lastChild = index;
+      }
+
+      elements.push_back(element);
+
+      if (!isEmptyElement)
+      {
+        openElements.push_back(OpenElement{index, XMLElement::INVALID_INDEX});
+      }
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnEndTag(std::string_view name)
+    {
+      if (openElements.empty())
+      {
+        boundaryEvents.push_back(BoundaryEvent{BoundaryType::END_TAG, XMLElement::INVALID_INDEX, name});
+        RETURN_OK();
+      }
+
+      if (elements[openElements.back().index].GetTag().name != name)
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+      }
+
+      openElements.pop_back();
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnContent(std::string_view content)
+    {
+      FXML_INSTRUMENT(++nrOfTextNodes);
+      if (openElements.empty())
+      {
+        boundaryEvents.push_back(BoundaryEvent{BoundaryType::CONTENT, XMLElement::INVALID_INDEX, content});
+        RETURN_OK();
+      }
+
+      elements[openElements.back().index].SetRawContent(content);
+
+      RETURN_OK();
+    }
+
+    std::expected<void, XMLError> OnComment(std::string_view)
+    {
+      FXML_INSTRUMENT(++nrOfComments);
+      RETURN_OK();
+    }
+  };
+
+  namespace
+  {
+    using namespace detail;
+
+    // Guesses where a tag starts at or after 'offset'. Comments, CDATA sections and processing instructions are stepped over since they may
+    // hide a '<'. A guess can still be wrong (e.g. 'offset' is inside a comment), the fix-up pass catches that and parses the chunk again
+    size_t FindChunkStart(std::string_view buffer, size_t offset)
+    {
+      while (true)
+      {
+        size_t const pos = buffer.find('<', offset);
+        if (pos == std::string_view::npos || pos + 1 >= buffer.size())
+        {
+          return buffer.size();
+        }
+
+        char const next = buffer[pos + 1];
+        if (next == '!' || next == '?')
+        {
+          std::string_view const terminator = buffer.substr(pos, CDATA_START.size()) == CDATA_START ? CDATA_END : (next == '?' ? "?>" : "-->");
+          size_t const end = buffer.find(terminator, pos + 2);
+          if (end == std::string_view::npos)
+          {
+            return buffer.size();
+          }
+
+          offset = end + terminator.size();
+          continue;
+        }
+
+        // Not the start of a tag, e.g. a stray '<' in an attribute value
+        if (std::isspace(static_cast<unsigned char>(next)))
+        {
+          offset = pos + 1;
+          continue;
+        }
+
+        return pos;
+      }
+    }
+
+    uint32_t Rebase(uint32_t index, uint32_t offset)
+    {
+      return index == XMLElement::INVALID_INDEX ? index : index + offset;
+    }
+  }  // namespace
+
+  std::expected<XMLDocument, XMLError> XMLParser::ParseBufferParallel(std::string_view buffer, size_t nrOfChunks)
+  {
+    std::vector<size_t> chunkStarts(nrOfChunks + 1);
+    for (size_t i{1}; i < nrOfChunks; ++i)
+    {
+      chunkStarts[i] = std::max(chunkStarts[i - 1], FindChunkStart(buffer, i * (buffer.size() / nrOfChunks)));
+    }
+    chunkStarts[nrOfChunks] = buffer.size();
+
+    std::vector<ChunkBuilder> chunks(nrOfChunks);
+    {
+      FXML_INSTRUMENT(ScopedTimer const tokenizeTimer{m_stats.tokenizeTime});
+      std::vector<std::jthread> workers;
+      workers.reserve(nrOfChunks - 1);
+      for (size_t i{1}; i < nrOfChunks; ++i)
+      {
+        workers.emplace_back([&chunks, &chunkStarts, buffer, i]() { chunks[i].Parse(buffer, chunkStarts[i], chunkStarts[i + 1]); });
+      }
+
+      // This thread takes the first chunk
+      chunks[0].Parse(buffer, 0, chunkStarts[1]);
+    }
+
+    // Fix-up pass, stitches the chunks together in document order
+    FXML_INSTRUMENT(ScopedTimer const buildTimer{m_stats.buildTime});
+    size_t nrOfElements{};
+    size_t nrOfAttributes{};
+    for (ChunkBuilder const& chunk : chunks)
+    {
+      nrOfElements += chunk.elements.size();
+      nrOfAttributes += chunk.attributes.size();
+    }
+
+    std::pmr::vector<XMLElement> elements{m_options.memoryResource};
+    std::pmr::vector<XMLAttribute> attributes{m_options.memoryResource};
+    std::vector<OpenElement> elementStack;
+    uint32_t lastTopLevelElement = XMLElement::INVALID_INDEX;
+    size_t position{};
+
+    // A chunk which gets parsed again may come out at a different size, this is only a first guess
+    elements.reserve(nrOfElements);
+    attributes.reserve(nrOfAttributes);
+
+    for (size_t i{}; i < nrOfChunks; ++i)
+    {
+      ChunkBuilder& chunk = chunks[i];
+
+      // The previous chunk did not stop where this one started, so the guess landed inside a token. Parse it again from the right spot
+      if (chunk.begin != position)
+      {
+        chunk.Parse(buffer, position, std::max(position, chunkStarts[i + 1]));
+      }
+      position = chunk.end;
+
+      uint32_t const elementOffset = static_cast<uint32_t>(elements.size());
+      uint32_t const attributeOffset = static_cast<uint32_t>(attributes.size());
+      for (XMLElement element : chunk.elements)
+      {
+        element.m_parent = Rebase(element.m_parent, elementOffset);
+        element.m_firstChild = Rebase(element.m_firstChild, elementOffset);
+        element.m_nextSibling = Rebase(element.m_nextSibling, elementOffset);
+        element.m_attributeOffset += attributeOffset;
+        elements.push_back(element);
+      }
+      attributes.insert(attributes.end(), chunk.attributes.begin(), chunk.attributes.end());
+
+      // Same checks and links as OnStartTag/OnEndTag/OnContent, for whatever crossed into an earlier chunk
+      for (ChunkBuilder::BoundaryEvent const& event : chunk.boundaryEvents)
+      {
+        switch (event.type)
+        {
+          case ChunkBuilder::BoundaryType::TOP_LEVEL_ELEMENT:
+          {
+            uint32_t const index = event.index + elementOffset;
+            uint32_t& previousSibling = elementStack.empty() ? lastTopLevelElement : elementStack.back().lastChild;
+            if (!elementStack.empty())
+            {
+              elements[index].m_parent = elementStack.back().index;
+              if (previousSibling == XMLElement::INVALID_INDEX)
+              {
+                elements[elements[index].m_parent].m_firstChild = index;
+              }
+            }
+            if (previousSibling != XMLElement::INVALID_INDEX)
+            {
+              elements[previousSibling].m_nextSibling = index;
+            }
+            previousSibling = index;
+            break;
+          }
+          case ChunkBuilder::BoundaryType::END_TAG:
+            if (elementStack.empty())
+            {
+              return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag reached while no start tag was parsed"}};
+            }
+            if (elements[elementStack.back().index].GetTag().name != event.text)
+            {
+              return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", event.text)}};
+            }
+            elementStack.pop_back();
+            break;
+          case ChunkBuilder::BoundaryType::CONTENT:
+            if (elementStack.empty())
+            {
+              return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Trying to parse content when no start tag was parsed"}};
+            }
+            elements[elementStack.back().index].SetRawContent(event.text);
+            break;
+        }
+      }
+
+      // Every boundary event happened before the error, so those get the first chance to report theirs
+      if (chunk.error.has_value())
+      {
+        return std::unexpected{*chunk.error};
+      }
+
+      for (OpenElement const& open : chunk.openElements)
+      {
+        elementStack.push_back(OpenElement{open.index + elementOffset, Rebase(open.lastChild, elementOffset)});
+      }
+    }
+
+    if (!elementStack.empty())
+    {
+      return std::unexpected{XMLError{
+          ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", elements[elementStack.back().index].GetTag().name)}};
+    }
+
+#if FXML_ENABLE_INSTRUMENTATION
+    CollectStats(elements, attributes);
+    for (ChunkBuilder const& chunk : chunks)
+    {
+      m_stats.nrOfComments += chunk.nrOfComments;
+      m_stats.nrOfTextNodes += chunk.nrOfTextNodes;
+      m_stats.bytesScanned += chunk.bytesScanned;
+    }
+#endif
+
+    XMLDocument doc{std::move(elements), std::move(attributes)};
+    if (m_options.buildIndex)
+    {
+      doc.BuildIndex();
+    }
+
+    return doc;
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "FXMLQuery.h"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  namespace
+  {
+    bool IsNameChar(char c)
+    {
+      return c != '/' && c != '[' && c != ']' && c != '@' && c != '=' && c != '\'' && c != '"' && !std::isspace(static_cast<unsigned char>(c));
+    }
+
+    std::string_view ReadName(std::string_view expression, size_t& pos)
+    {
+      size_t const start = pos;
+      while (pos < expression.size() && IsNameChar(expression[pos]))
+      {
+        ++pos;
+      }
+
+      return expression.substr(start, pos - start);
+    }
+
+    // Stands in for the output string of DecodeReferences, compares the decoded text with 'expected' instead of storing it
+    struct DecodedComparer
+    {
+      std::string_view expected;
+      size_t pos{};
+      bool equal = true;
+
+      void push_back(char c)
+      {
+        equal = equal && pos < expected.size() && expected[pos] == c;
+        ++pos;
+      }
+
+      void append(std::string_view text)
+      {
+        equal = equal && expected.substr(std::min(pos, expected.size())).starts_with(text);
+        pos += text.size();
+      }
+    };
+
+    bool DecodedEquals(std::string_view raw, std::string_view expected)
+    {
+      if (raw.find('&') == std::string_view::npos)
+      {
+        return raw == expected;
+      }
+
+      DecodedComparer comparer{expected};
+      detail::DecodeReferences(raw, comparer);
+      return comparer.equal && comparer.pos == expected.size();
+    }
+
+    XMLError QueryError(std::string_view expression, size_t pos, std::string_view reason)
+    {
+      return XMLError{ErrorReason::PARSE_ERROR, std::format("Query '{}' is malformed at offset {}: {}", expression, pos, reason)};
+    }
+  }  // namespace
+
+  std::expected<XMLQuery, XMLError> XMLQuery::Compile(std::string_view expression)
+  {
+    XMLQuery query{};
+
+    size_t pos{};
+    Axis axis = Axis::DESCENDANT;  // A relative path is evaluated against the document, so it matches at any depth
+    if (expression.starts_with("//"))
+    {
+      pos = 2;
+    }
+    else if (expression.starts_with('/'))
+    {
+      axis = Axis::CHILD;
+      pos = 1;
+    }
+
+    while (true)
+    {
+      Step step{axis, std::string(ReadName(expression, pos)), {}, 0};
+      if (step.name.empty())
+      {
+        return std::unexpected{QueryError(expression, pos, "expected a name or '*'")};
+      }
+
+      while (pos < expression.size() && expression[pos] == '[')
+      {
+        ++pos;
+        if (step.position != 0)
+        {
+          return std::unexpected{QueryError(expression, pos, "a positional predicate must be the last one of its step")};
+        }
+
+        if (pos < expression.size() && expression[pos] == '@')
+        {
+          ++pos;
+          AttributeTest test{std::string(ReadName(expression, pos)), std::nullopt};
+          if (test.key.empty())
+          {
+            return std::unexpected{QueryError(expression, pos, "expected an attribute name")};
+          }
+
+          if (pos < expression.size() && expression[pos] == '=')
+          {
+            ++pos;
+            char const quote = pos < expression.size() ? expression[pos] : '\0';
+            size_t const end = quote == '\'' || quote == '"' ? expression.find(quote, pos + 1) : std::string_view::npos;
+            if (end == std::string_view::npos)
+            {
+              return std::unexpected{QueryError(expression, pos, "expected a quoted attribute value")};
+            }
+
+            test.value = std::string(expression.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+          }
+
+          step.attributes.push_back(std::move(test));
+        }
+        else
+        {
+          auto const [end, ec] = std::from_chars(expression.data() + pos, expression.data() + expression.size(), step.position);
+          if (ec != std::errc{} || step.position == 0)
+          {
+            return std::unexpected{QueryError(expression, pos, "expected '@' or a position of at least 1")};
+          }
+
+          pos = static_cast<size_t>(end - expression.data());
+        }
+
+        if (pos >= expression.size() || expression[pos] != ']')
+        {
+          return std::unexpected{QueryError(expression, pos, "expected ']'")};
+        }
+        ++pos;
+      }
+
+      query.m_steps.push_back(std::move(step));
+
+      if (pos == expression.size())
+      {
+        return query;
+      }
+
+      if (expression.substr(pos, 2) == "//")
+      {
+        axis = Axis::DESCENDANT;
+        pos += 2;
+      }
+      else if (expression[pos] == '/')
+      {
+        axis = Axis::CHILD;
+        pos += 1;
+      }
+      else
+      {
+        return std::unexpected{QueryError(expression, pos, "expected '/'")};
+      }
+    }
+  }
+
+  std::optional<std::reference_wrapper<XMLElement const>> XMLQuery::First(XMLDocument const& document) const
+  {
+    std::optional<std::reference_wrapper<XMLElement const>> first;
+    ForEach(document,
+            [&first](XMLElement const& element)
+            {
+              first = element;
+              return false;
+            });
+
+    return first;
+  }
+
+  size_t XMLQuery::Count(XMLDocument const& document) const
+  {
+    size_t count{};
+    ForEach(document, [&count](XMLElement const&) { ++count; });
+
+    return count;
+  }
+
+  bool XMLQuery::Matches(XMLDocument const& document, uint32_t index) const
+  {
+    NameIds nameIds;
+    return ResolveNames(document, nameIds) && MatchesFrom(document, nameIds.ids, index, m_steps.size() - 1);
+  }
+
+  std::vector<XMLQuery::Step> const& XMLQuery::GetSteps() const
+  {
+    return m_steps;
+  }
+
+  bool XMLQuery::ResolveNames(XMLDocument const& document, NameIds& nameIds) const
+  {
+    if (m_steps.size() <= NameIds::NR_OF_INLINE_IDS)
+    {
+      nameIds.ids = std::span<uint32_t>{nameIds.inlineIds}.first(m_steps.size());
+    }
+    else
+    {
+      nameIds.heapIds.resize(m_steps.size());
+      nameIds.ids = nameIds.heapIds;
+    }
+
+    for (size_t i{}; i < m_steps.size(); ++i)
+    {
+      if (m_steps[i].name == "*")
+      {
+        nameIds.ids[i] = XMLNameTable::INVALID_ID;
+      }
+      else if (nameIds.ids[i] = document.GetNameId(m_steps[i].name); nameIds.ids[i] == XMLNameTable::INVALID_ID)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool XMLQuery::MatchesFrom(XMLDocument const& document, std::span<uint32_t const> nameIds, uint32_t index, size_t step) const
+  {
+    if (!MatchesStep(document, nameIds[step], index, m_steps[step]))
+    {
+      return false;
+    }
+
+    uint32_t parent = document.m_elements[index].m_parent;
+    if (step == 0)
+    {
+      return m_steps[0].axis == Axis::DESCENDANT || parent == XMLElement::INVALID_INDEX;
+    }
+
+    if (m_steps[step].axis == Axis::CHILD)
+    {
+      return parent != XMLElement::INVALID_INDEX && MatchesFrom(document, nameIds, parent, step - 1);
+    }
+
+    // Any ancestor may match the previous step
+    for (; parent != XMLElement::INVALID_INDEX; parent = document.m_elements[parent].m_parent)
+    {
+      if (MatchesFrom(document, nameIds, parent, step - 1))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool XMLQuery::MatchesStep(XMLDocument const& document, uint32_t nameId, uint32_t index, Step const& step) const
+  {
+    if (!MatchesNameAndAttributes(document, nameId, index, step))
+    {
+      return false;
+    }
+
+    if (step.position == 0)
+    {
+      return true;
+    }
+
+    // Count the matching siblings in front of this one, stopping as soon as the position has been reached
+    uint32_t const parent = document.m_elements[index].m_parent;
+    uint32_t sibling = parent == XMLElement::INVALID_INDEX ? 0 : document.m_elements[parent].m_firstChild;
+    for (uint32_t position{}; sibling != XMLElement::INVALID_INDEX; sibling = document.m_elements[sibling].m_nextSibling)
+    {
+      if (MatchesNameAndAttributes(document, nameId, sibling, step) && ++position == step.position)
+      {
+        return sibling == index;
+      }
+    }
+
+    return false;
+  }
+
+  bool XMLQuery::MatchesNameAndAttributes(XMLDocument const& document, uint32_t nameId, uint32_t index, Step const& step) const
+  {
+    XMLElement const& element = document.m_elements[index];
+    if (nameId != XMLNameTable::INVALID_ID && element.m_nameId != nameId)
+    {
+      return false;
+    }
+
+    for (AttributeTest const& test : step.attributes)
+    {
+      std::optional<std::string_view> const value = element.GetTag().attributes.find(test.key);
+      if (!value.has_value() || (test.value.has_value() && !DecodedEquals(*value, *test.value)))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "FXMLReader.h"
+
+#include <format>
+
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  XMLLazyAttributeIterator::XMLLazyAttributeIterator(std::string_view rawTag, size_t offset)
+    : m_rawTag(rawTag)
+    , m_offset(offset)
+  {
+    ++(*this);
+  }
+
+  XMLAttribute const& XMLLazyAttributeIterator::operator*() const
+  {
+    return *m_attribute;
+  }
+
+  XMLAttribute const* XMLLazyAttributeIterator::operator->() const
+  {
+    return &*m_attribute;
+  }
+
+  XMLLazyAttributeIterator& XMLLazyAttributeIterator::operator++()
+  {
+    auto const attribute = detail::NextAttribute(m_rawTag, m_offset);
+    m_attribute = attribute.has_value() ? attribute.value() : std::nullopt;
+
+    return *this;
+  }
+
+  XMLLazyAttributeIterator XMLLazyAttributeIterator::operator++(int)
+  {
+    XMLLazyAttributeIterator const copy{*this};
+    ++(*this);
+    return copy;
+  }
+
+  bool XMLLazyAttributeIterator::operator==(XMLLazyAttributeIterator const& other) const
+  {
+    // Every exhausted iterator is the end iterator
+    if (!m_attribute.has_value() || !other.m_attribute.has_value())
+    {
+      return m_attribute.has_value() == other.m_attribute.has_value();
+    }
+
+    return m_rawTag.data() == other.m_rawTag.data() && m_offset == other.m_offset;
+  }
+
+  XMLLazyAttributes::XMLLazyAttributes(std::string_view rawTag, size_t offset)
+    : m_rawTag(rawTag)
+    , m_offset(offset)
+  {
+  }
+
+  std::optional<std::string_view> XMLLazyAttributes::find(std::string_view key) const
+  {
+    for (XMLAttribute const& attribute : *this)
+    {
+      if (attribute.key == key)
+      {
+        return attribute.value;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  XMLLazyAttributeIterator XMLLazyAttributes::begin() const
+  {
+    return XMLLazyAttributeIterator{m_rawTag, m_offset};
+  }
+
+  XMLLazyAttributeIterator XMLLazyAttributes::end() const
+  {
+    return XMLLazyAttributeIterator{};
+  }
+
+  XMLReader::XMLReader(std::string_view xml)
+    : m_buffer(xml)
+  {
+  }
+
+  std::expected<bool, XMLError> XMLReader::Next()
+  {
+    // Processing instructions produce no node, keep going until one does
+    do
+    {
+      m_type = XMLNodeType::NONE;
+
+      CHECK_EXPECTED_NO_TRANSFORM(bool, parsed, Tokenizer{*this}.ParseToken(m_buffer, m_bufferPointer));
+      if (!parsed)
+      {
+        if (!m_openNames.empty())
+        {
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", m_openNames.back())}};
+        }
+
+        return false;
+      }
+    } while (m_type == XMLNodeType::NONE);
+
+    return true;
+  }
+
+  std::expected<void, XMLError> XMLReader::SkipSubtree()
+  {
+    using namespace detail;
+
+    if (m_type != XMLNodeType::START_ELEMENT)
+    {
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "SkipSubtree can only be called on a start tag"}};
+    }
+
+    if (m_isEmptyElement)
+    {
+      RETURN_OK();
+    }
+
+    // Only the nesting depth is tracked, names and attributes of the skipped elements are never looked at
+    size_t depth{1};
+    size_t pos{m_bufferPointer};
+    while (true)
+    {
+      // The error messages only get formatted when the check fails
+      CHECK_EXPECTED(size_t, open, SafeFind(m_buffer, '<', pos), std::format("EOF reached while tag '{}' is still open", m_openNames.back()));
+      CHECK_EXPECTED(char, kind, SafeAccess(m_buffer, open + 1), std::format("EOF reached while tag '{}' is still open", m_openNames.back()));
+
+      // A '<' inside a comment or CDATA section does not open anything
+      if (kind == '!')
+      {
+        if (m_buffer.substr(open, CDATA_START.size()) == CDATA_START)
+        {
+          CHECK_EXPECTED(size_t, end, SafeFind(m_buffer, CDATA_END, open + CDATA_START.size()), "CDATA section is not closed");
+          pos = end + CDATA_END.size();
+        }
+        else
+        {
+          CHECK_EXPECTED(size_t, end, SafeFind(m_buffer, "-->", open + 1), "Comment is not closed");
+          pos = end + 3;
+        }
+        continue;
+      }
+
+      if (kind == '?')
+      {
+        CHECK_EXPECTED(size_t, end, SafeFind(m_buffer, "?>", open + 2), "Processing instruction is not closed");
+        pos = end + 2;
+        continue;
+      }
+
+      CHECK_EXPECTED(size_t, close, SafeFindTagEnd(m_buffer, open + 1), "Could not find closing bracket of tag");
+      pos = close + 1;
+
+      if (kind != '/')
+      {
+        if (m_buffer[close - 1] != '/')
+        {
+          ++depth;
+        }
+      }
+      else if (--depth == 0)
+      {
+        m_bufferPointer = open;
+        break;
+      }
+    }
+
+    // The matching end tag goes through the tokenizer, so it still gets checked against the start tag
+    m_type = XMLNodeType::NONE;
+    CHECK_EXPECTED_VOID(Tokenizer{*this}.ParseToken(m_buffer, m_bufferPointer));
+
+    RETURN_OK();
+  }
+
+  XMLNodeType XMLReader::Type() const
+  {
+    return m_type;
+  }
+
+  std::string_view XMLReader::Name() const
+  {
+    return m_name;
+  }
+
+  XMLLazyAttributes XMLReader::Attributes() const
+  {
+    if (m_type != XMLNodeType::START_ELEMENT)
+    {
+      return XMLLazyAttributes{};
+    }
+
+    return XMLLazyAttributes{m_rawTag, m_name.size() + 1};
+  }
+
+  std::string_view XMLReader::Text() const
+  {
+    return m_text;
+  }
+
+  bool XMLReader::IsEmptyElement() const
+  {
+    return m_isEmptyElement;
+  }
+
+  size_t XMLReader::Depth() const
+  {
+    // The start tag of a non-empty element is already on the stack
+    if (m_type == XMLNodeType::START_ELEMENT && !m_isEmptyElement)
+    {
+      return m_openNames.size() - 1;
+    }
+
+    return m_openNames.size();
+  }
+
+  bool XMLReader::HasOpenElement() const
+  {
+    return !m_openNames.empty();
+  }
+
+  std::expected<void, XMLError> XMLReader::OnRawStartTag(std::string_view name, std::string_view rawTag, bool isEmptyElement)
+  {
+    m_type = XMLNodeType::START_ELEMENT;
+    m_name = name;
+    m_rawTag = rawTag;
+    m_text = {};
+    m_isEmptyElement = isEmptyElement;
+
+    if (!isEmptyElement)
+    {
+      m_openNames.push_back(name);
+    }
+
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLReader::OnEndTag(std::string_view name)
+  {
+    if (m_openNames.back() != name)
+    {
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+    }
+
+    m_openNames.pop_back();
+
+    m_type = XMLNodeType::END_ELEMENT;
+    m_name = name;
+    m_rawTag = {};
+    m_text = {};
+    m_isEmptyElement = false;
+
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLReader::OnContent(std::string_view content)
+  {
+    m_type = XMLNodeType::TEXT;
+    m_name = {};
+    m_rawTag = {};
+    m_text = content;
+    m_isEmptyElement = false;
+
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLReader::OnComment(std::string_view comment)
+  {
+    m_type = XMLNodeType::COMMENT;
+    m_name = {};
+    m_rawTag = {};
+    m_text = comment;
+    m_isEmptyElement = false;
+
+    RETURN_OK();
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "FXMLSax.h"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+
+#include "FXMLCompressed.h"
+#include "FXMLTokenizer.h"
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  std::expected<void, XMLError> XMLSaxHandler::OnStartElement(std::string_view, XMLAttributes)
+  {
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLSaxHandler::OnEndElement(std::string_view)
+  {
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLSaxHandler::OnText(std::string_view)
+  {
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLSaxHandler::OnComment(std::string_view)
+  {
+    RETURN_OK();
+  }
+
+  XMLSaxParser::XMLSaxParser(size_t chunkSize)
+    : m_chunkSize(chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE)
+  {
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::Parse(std::string_view filepath, XMLSaxHandler& handler)
+  {
+    CHECK_EXPECTED_VOID(detail::GetFileSize(filepath));
+
+    std::ifstream file{std::string(filepath), std::ios::binary};
+    if (!file.is_open())
+    {
+      return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for reading", filepath)}};
+    }
+
+    return ParseChunks(
+        [&file](std::span<char> chunk) -> std::expected<size_t, XMLError>
+        {
+          file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+          if (file.bad())
+          {
+            return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, "Reading from file failed"}};
+          }
+
+          return static_cast<size_t>(file.gcount());
+        },
+        handler);
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::ParseCompressed(std::string_view filepath, XMLSaxHandler& handler)
+  {
+    XMLCompressedReader reader;
+    CHECK_EXPECTED_VOID(reader.Open(filepath));
+
+    return ParseChunks([&reader](std::span<char> chunk) { return reader.Read(chunk); }, handler);
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::ParseFromMemory(std::string_view xml, XMLSaxHandler& handler)
+  {
+    Reset(handler);
+
+    // Everything is in memory already, no need to go through the chunk buffer
+    size_t bufferPointer{};
+    CHECK_EXPECTED_VOID(Tokenizer{*this}.ParseDocument(xml, bufferPointer));
+
+    return CheckAllElementsClosed();
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::ParseChunks(ChunkReader const& reader, XMLSaxHandler& handler)
+  {
+    Reset(handler);
+
+    if (m_chunk.size() < m_chunkSize)
+    {
+      m_chunk.resize(m_chunkSize);
+    }
+
+    Tokenizer tokenizer{*this};
+    size_t begin{};  // First byte the tokenizer has not consumed yet
+    size_t end{};    // One past the last byte read
+    bool finalChunk{false};
+    while (!finalChunk)
+    {
+      // Move the unparsed tail to the front, a token cut off by the previous chunk continues from there
+      if (begin > 0)
+      {
+        std::memmove(m_chunk.data(), m_chunk.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+
+      // A single token does not fit in the chunk, only then does the buffer grow
+      if (end == m_chunk.size())
+      {
+        m_chunk.resize(m_chunk.size() * 2);
+      }
+
+      CHECK_EXPECTED_NO_TRANSFORM(size_t, bytesRead, reader(std::span<char>{m_chunk}.subspan(end)));
+      end += bytesRead;
+      finalChunk = bytesRead == 0;
+
+      CHECK_EXPECTED_VOID(tokenizer.ParseDocument(std::string_view{m_chunk.data(), end}, begin, finalChunk));
+    }
+
+    return CheckAllElementsClosed();
+  }
+
+  void XMLSaxParser::Reset(XMLSaxHandler& handler)
+  {
+    m_handler = &handler;
+    m_attributes.clear();
+    m_openNames.clear();
+    m_openNameOffsets.clear();
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::CheckAllElementsClosed() const
+  {
+    if (!m_openNameOffsets.empty())
+    {
+      std::string_view const name = std::string_view{m_openNames}.substr(m_openNameOffsets.back());
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("EOF reached while tag '{}' is still open", name)}};
+    }
+
+    RETURN_OK();
+  }
+
+  std::vector<XMLAttribute>& XMLSaxParser::GetAttributeStorage()
+  {
+    return m_attributes;
+  }
+
+  bool XMLSaxParser::HasOpenElement() const
+  {
+    return !m_openNameOffsets.empty();
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::OnStartTag(std::string_view name, std::span<XMLAttribute const> attributes, bool isEmptyElement)
+  {
+    auto const result = m_handler->OnStartElement(name, XMLAttributes{attributes});
+    m_attributes.clear();
+    CHECK_EXPECTED_VOID(result);
+
+    if (isEmptyElement)
+    {
+      return m_handler->OnEndElement(name);
+    }
+
+    m_openNameOffsets.push_back(m_openNames.size());
+    m_openNames.append(name);
+
+    RETURN_OK();
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::OnEndTag(std::string_view name)
+  {
+    size_t const offset = m_openNameOffsets.back();
+    if (std::string_view{m_openNames}.substr(offset) != name)
+    {
+      return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("No matching start tag found for end tag '{}'", name)}};
+    }
+
+    m_openNames.resize(offset);
+    m_openNameOffsets.pop_back();
+
+    return m_handler->OnEndElement(name);
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::OnContent(std::string_view content)
+  {
+    return m_handler->OnText(content);
+  }
+
+  std::expected<void, XMLError> XMLSaxParser::OnComment(std::string_view comment)
+  {
+    return m_handler->OnComment(comment);
+  }
+}  // namespace fxml
\ No newline at end of file
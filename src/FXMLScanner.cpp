@@ -0,0 +1,188 @@
+#include "FXMLScanner.h"
+
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FXML_SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__GNUG__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace fxml
+{
+  namespace
+  {
+    using FindFirstOfKernel = size_t (*)(char const*, size_t, size_t, CharSet const&);
+
+    size_t CountTrailingZeros(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return index;
+#else
+      return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    size_t FindFirstOfScalar(char const* data, size_t size, size_t offset, CharSet const& chars)
+    {
+      for (size_t i{offset}; i < size; ++i)
+      {
+        if (chars.Contains(data[i]))
+        {
+          return i;
+        }
+      }
+
+      return std::string_view::npos;
+    }
+
+#ifdef FXML_SCANNER_X86
+    size_t FindFirstOfSSE2(char const* data, size_t size, size_t offset, CharSet const& chars)
+    {
+      // Broadcast every needle once, the block loop then only does loads, compares and ORs
+      __m128i needles[CharSet::MAX_CHARS];
+      size_t const nrOfNeedles = chars.Size();
+      for (size_t i{}; i < nrOfNeedles; ++i)
+      {
+        needles[i] = _mm_set1_epi8(chars.Chars()[i]);
+      }
+
+      size_t i{offset};
+      for (; i + 16 <= size; i += 16)
+      {
+        __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+        __m128i matches = _mm_setzero_si128();
+        for (size_t n{}; n < nrOfNeedles; ++n)
+        {
+          matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, needles[n]));
+        }
+
+        if (uint32_t const mask = static_cast<uint32_t>(_mm_movemask_epi8(matches)); mask != 0)
+        {
+          return i + CountTrailingZeros(mask);
+        }
+      }
+
+      return FindFirstOfScalar(data, size, i, chars);
+    }
+
+    TARGET_AVX2 size_t FindFirstOfAVX2(char const* data, size_t size, size_t offset, CharSet const& chars)
+    {
+      __m256i needles[CharSet::MAX_CHARS];
+      size_t const nrOfNeedles = chars.Size();
+      for (size_t i{}; i < nrOfNeedles; ++i)
+      {
+        needles[i] = _mm256_set1_epi8(chars.Chars()[i]);
+      }
+
+      size_t i{offset};
+      for (; i + 32 <= size; i += 32)
+      {
+        __m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+        __m256i matches = _mm256_setzero_si256();
+        for (size_t n{}; n < nrOfNeedles; ++n)
+        {
+          matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, needles[n]));
+        }
+
+        if (uint32_t const mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches)); mask != 0)
+        {
+          return i + CountTrailingZeros(mask);
+        }
+      }
+
+      // Finish off with the 16-byte kernel, it handles the scalar tail as well
+      return FindFirstOfSSE2(data, size, i, chars);
+    }
+
+    bool CPUSupportsAVX2()
+    {
+#if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 1);
+      bool const osUsesXSave = (info[2] & (1 << 27)) != 0;
+      bool const cpuSupportsAVX = (info[2] & (1 << 28)) != 0;
+      if (!osUsesXSave || !cpuSupportsAVX)
+      {
+        return false;
+      }
+
+      // The OS must save the YMM registers on context switches
+      if ((_xgetbv(0) & 0x6) != 0x6)
+      {
+        return false;
+      }
+
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+#else
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    ScannerKernel SelectKernel()
+    {
+#ifdef FXML_SCANNER_X86
+      return CPUSupportsAVX2() ? ScannerKernel::AVX2 : ScannerKernel::SSE2;
+#else
+      return ScannerKernel::SCALAR;
+#endif
+    }
+
+    FindFirstOfKernel GetFindFirstOfKernel(ScannerKernel kernel)
+    {
+      switch (kernel)
+      {
+#ifdef FXML_SCANNER_X86
+        case ScannerKernel::AVX2:
+          return &FindFirstOfAVX2;
+        case ScannerKernel::SSE2:
+          return &FindFirstOfSSE2;
+#endif
+        default:
+          return &FindFirstOfScalar;
+      }
+    }
+
+    size_t FindFirstOfFirstCall(char const* data, size_t size, size_t offset, CharSet const& chars);
+
+    // Constant-initialised, so scanning from another translation unit's static initialisation works too. Starts out at a stub which
+    // picks the kernel on the first call, threads racing on that first call all store the same kernel
+    constinit std::atomic<FindFirstOfKernel> g_findFirstOf{&FindFirstOfFirstCall};
+
+    size_t FindFirstOfFirstCall(char const* data, size_t size, size_t offset, CharSet const& chars)
+    {
+      FindFirstOfKernel const kernel = GetFindFirstOfKernel(GetScannerKernel());
+      g_findFirstOf.store(kernel, std::memory_order_relaxed);
+      return kernel(data, size, offset, chars);
+    }
+  }  // namespace
+
+  ScannerKernel GetScannerKernel()
+  {
+    static ScannerKernel const kernel = SelectKernel();
+    return kernel;
+  }
+
+  size_t FindFirstOf(std::string_view buffer, CharSet const& chars, size_t offset)
+  {
+    if (offset >= buffer.size())
+    {
+      return std::string_view::npos;
+    }
+
+    return g_findFirstOf.load(std::memory_order_relaxed)(buffer.data(), buffer.size(), offset, chars);
+  }
+}  // namespace fxml
\ No newline at end of file
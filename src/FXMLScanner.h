@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+namespace fxml
+{
+  /*
+  A small set of bytes which can be searched for in a single pass over a buffer
+  The SIMD kernels compare every block against each byte in the set, so keep sets small
+  */
+  class CharSet
+  {
+   public:
+    static constexpr size_t MAX_CHARS = 16;
+
+   private:
+    std::array<char, MAX_CHARS> m_chars{};
+    std::array<bool, 256> m_table{};
+    size_t m_size = 0;
+
+   public:
+    constexpr CharSet(std::initializer_list<char> chars)
+    {
+      for (char const c : chars)
+      {
+        if (m_size < MAX_CHARS && !m_table[static_cast<uint8_t>(c)])
+        {
+          m_chars[m_size++] = c;
+          m_table[static_cast<uint8_t>(c)] = true;
+        }
+      }
+    }
+
+    constexpr bool Contains(char c) const
+    {
+      return m_table[static_cast<uint8_t>(c)];
+    }
+
+    constexpr char const* Chars() const
+    {
+      return m_chars.data();
+    }
+
+    constexpr size_t Size() const
+    {
+      return m_size;
+    }
+  };
+
+  inline constexpr CharSet WHITESPACE_CHARS{' ', '\t', '\n', '\r'};
+  inline constexpr CharSet STRUCTURAL_CHARS{'<', '>', '=', '"', '\'', '&', ' ', '\t', '\n', '\r'};
+
+  enum class ScannerKernel
+  {
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2
+  };
+
+  // The kernel is chosen once at startup, based on what the CPU supports
+  ScannerKernel GetScannerKernel();
+
+  // Returns the position of the first byte at or after 'offset' which is in 'chars', or std::string_view::npos
+  size_t FindFirstOf(std::string_view buffer, CharSet const& chars, size_t offset = 0);
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "FXMLSnapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "FXMLUtils.h"
+
+namespace fxml
+{
+  namespace
+  {
+    using namespace detail;
+
+    // File layout: header, element records, attribute records, source text. Every record is 8-byte aligned
+    constexpr char MAGIC[8] = {'F', 'X', 'M', 'L', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    constexpr uint64_t NO_VIEW = ~uint64_t{0};
+
+    struct SnapshotHeader
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t byteOrder;
+      uint64_t sourceSize;
+      uint64_t sourceChecksum;
+      uint64_t nrOfElements;
+      uint64_t nrOfAttributes;
+    };
+
+    // Offset into the source text, NO_VIEW for a view which points nowhere
+    struct SnapshotView
+    {
+      uint64_t offset;
+      uint64_t size;
+    };
+
+    struct SnapshotElement
+    {
+      SnapshotView name;
+      SnapshotView content;
+      uint32_t parent;
+      uint32_t firstChild;
+      uint32_t nextSibling;
+      uint32_t attributeOffset;
+      uint32_t attributeCount;
+      uint32_t padding;
+    };
+
+    struct SnapshotAttribute
+    {
+      SnapshotView key;
+      SnapshotView value;
+    };
+
+    static_assert(sizeof(SnapshotHeader) % 8 == 0 && sizeof(SnapshotElement) % 8 == 0 && sizeof(SnapshotAttribute) % 8 == 0);
+
+    XMLError InvalidSnapshot(std::string_view snapshotPath, std::string_view reason)
+    {
+      return XMLError{ErrorReason::INVALID_SNAPSHOT, std::format("'{}' is not a usable snapshot: {}", snapshotPath, reason)};
+    }
+
+    std::expected<SnapshotView, XMLError> ToSnapshotView(std::string_view view, std::string_view text)
+    {
+      if (view.data() == nullptr)
+      {
+        return SnapshotView{NO_VIEW, 0};
+      }
+
+      if (view.data() < text.data() || view.data() + view.size() > text.data() + text.size())
+      {
+        return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Document does not point into the given text"}};
+      }
+
+      return SnapshotView{static_cast<uint64_t>(view.data() - text.data()), view.size()};
+    }
+
+    std::optional<std::string_view> FromSnapshotView(SnapshotView const& view, std::string_view text)
+    {
+      if (view.offset == NO_VIEW)
+      {
+        return std::string_view{};
+      }
+
+      if (view.offset > text.size() || view.size > text.size() - view.offset)
+      {
+        return std::nullopt;
+      }
+
+      return text.substr(view.offset, view.size);
+    }
+  }  // namespace
+
+  uint64_t XMLSnapshot::Checksum(std::string_view text)
+  {
+    // A word at a time, getting the text off the disk is what takes long and not the mixing
+    constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+    uint64_t hash = 0xCBF29CE484222325ull ^ (text.size() * MULTIPLIER);
+    size_t i{};
+    for (; i + sizeof(uint64_t) <= text.size(); i += sizeof(uint64_t))
+    {
+      uint64_t word;
+      std::memcpy(&word, text.data() + i, sizeof(word));
+      hash = (hash ^ word) * MULTIPLIER;
+      hash ^= hash >> 32;
+    }
+
+    uint64_t tail{};
+    if (i < text.size())
+    {
+      std::memcpy(&tail, text.data() + i, text.size() - i);
+    }
+    hash = (hash ^ tail) * MULTIPLIER;
+
+    // murmur3 finalizer
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  std::expected<void, XMLError> XMLSnapshot::Write(XMLDocument const& document, std::string_view snapshotPath)
+  {
+    if (document.m_source.GetText().empty() && document.GetNrOfNodes() > 0)
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Document does not own its text, pass the text it was parsed from"}};
+    }
+
+    return Write(document, document.m_source.GetText(), snapshotPath);
+  }
+
+  std::expected<void, XMLError> XMLSnapshot::Write(XMLDocument const& document, std::string_view text, std::string_view snapshotPath)
+  {
+    // Loading a snapshot gives back every element of its text, which a filtered document does not have
+    if (document.m_filtered)
+    {
+      return std::unexpected{XMLError{ErrorReason::INVALID_ARGUMENT, "Documents of a filtered parse cannot be snapshotted"}};
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.sourceSize = text.size();
+    header.sourceChecksum = Checksum(text);
+    header.nrOfElements = document.m_elements.size();
+    header.nrOfAttributes = document.m_attributes.size();
+
+    std::vector<SnapshotElement> elements;
+    elements.reserve(document.m_elements.size());
+    for (XMLElement const& element : document.m_elements)
+    {
+      CHECK_EXPECTED_NO_TRANSFORM(SnapshotView, name, ToSnapshotView(element.m_tag.name, text));
+      CHECK_EXPECTED_NO_TRANSFORM(SnapshotView, content, ToSnapshotView(element.m_rawContent, text));
+      elements.push_back(SnapshotElement{name, content, element.m_parent, element.m_firstChild, element.m_nextSibling, element.m_attributeOffset,
+                                         element.m_attributeCount, 0});
+    }
+
+    std::vector<SnapshotAttribute> attributes;
+    attributes.reserve(document.m_attributes.size());
+    for (XMLAttribute const& attribute : document.m_attributes)
+    {
+      CHECK_EXPECTED_NO_TRANSFORM(SnapshotView, key, ToSnapshotView(attribute.key, text));
+      CHECK_EXPECTED_NO_TRANSFORM(SnapshotView, value, ToSnapshotView(attribute.value, text));
+      attributes.push_back(SnapshotAttribute{key, value});
+    }
+
+    // Written next to the snapshot and renamed over it, so a reader never sees half a file
+    // Every writer gets its own temporary file, processes writing the same snapshot at once would write into each other's otherwise
+    std::random_device random;
+    std::string const temporaryPath = std::format("{}.{:08x}{:08x}.tmp", snapshotPath, random(), random());
+    {
+      std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+      if (!file.is_open())
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not open '{}' for writing", temporaryPath)}};
+      }
+
+      file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+      file.write(reinterpret_cast<char const*>(elements.data()), static_cast<std::streamsize>(elements.size() * sizeof(SnapshotElement)));
+      file.write(reinterpret_cast<char const*>(attributes.data()), static_cast<std::streamsize>(attributes.size() * sizeof(SnapshotAttribute)));
+      file.write(text.data(), static_cast<std::streamsize>(text.size()));
+      if (!file.flush())
+      {
+        file.close();
+        std::error_code ec;
+        std::filesystem::remove(temporaryPath, ec);
+        return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Writing to '{}' failed", temporaryPath)}};
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporaryPath, std::string{snapshotPath}, ec);
+    if (ec)
+    {
+      std::filesystem::remove(temporaryPath, ec);
+      return std::unexpected{XMLError{ErrorReason::CANNOT_OPEN_FILE, std::format("Could not move the snapshot to '{}'", snapshotPath)}};
+    }
+
+    RETURN_OK();
+  }
+
+  std::expected<XMLDocument, XMLError> XMLSnapshot::Load(std::string_view snapshotPath, size_t sourceSize, uint64_t sourceChecksum,
+                                                         std::pmr::memory_resource* memoryResource)
+  {
+    CHECK_EXPECTED_NO_TRANSFORM(size_t, fileSize, GetFileSize(snapshotPath));
+
+    // The header decides whether the rest is worth mapping at all
+    SnapshotHeader header{};
+    {
+      std::ifstream file{std::string(snapshotPath), std::ios::binary};
+      if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      {
+        return std::unexpected{InvalidSnapshot(snapshotPath, "too small")};
+      }
+    }
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK)
+    {
+      return std::unexpected{InvalidSnapshot(snapshotPath, "not a snapshot of this platform")};
+    }
+    if (header.version != VERSION)
+    {
+      return std::unexpected{InvalidSnapshot(snapshotPath, std::format("version {} instead of {}", header.version, VERSION))};
+    }
+    if (header.sourceSize != sourceSize || header.sourceChecksum != sourceChecksum)
+    {
+      return std::unexpected{InvalidSnapshot(snapshotPath, "the source changed")};
+    }
+
+    uint64_t const maxRecords = fileSize / sizeof(SnapshotAttribute);
+    if (header.nrOfElements >= XMLElement::INVALID_INDEX || header.nrOfElements > maxRecords || header.nrOfAttributes > maxRecords ||
+        sizeof(SnapshotHeader) + header.nrOfElements * sizeof(SnapshotElement) + header.nrOfAttributes * sizeof(SnapshotAttribute) + header.sourceSize !=
+            fileSize)
+    {
+      return std::unexpected{InvalidSnapshot(snapshotPath, "truncated")};
+    }
+
+    size_t const elementsOffset = sizeof(SnapshotHeader);
+    size_t const attributesOffset = elementsOffset + header.nrOfElements * sizeof(SnapshotElement);
+    size_t const textOffset = attributesOffset + header.nrOfAttributes * sizeof(SnapshotAttribute);
+
+    CHECK_EXPECTED_NO_TRANSFORM(void*, view, MapFile(snapshotPath, fileSize, MemoryMap{}));
+    char const* const base = static_cast<char const*>(view);
+    XMLSource source{base + textOffset, header.sourceSize, [base, fileSize](char const*, size_t) { UnmapFile(const_cast<char*>(base), fileSize); }};
+    std::string_view const text = source.GetText();
+
+    // Single pass back to views, checking every offset and link so a damaged file cannot make the document point outside of it or loop
+    std::pmr::memory_resource* const resource = memoryResource ? memoryResource : std::pmr::get_default_resource();
+    uint32_t const nrOfElements = static_cast<uint32_t>(header.nrOfElements);
+    std::pmr::vector<XMLElement> elements{resource};
+    elements.reserve(nrOfElements);
+    for (uint32_t i{}; i < nrOfElements; ++i)
+    {
+      SnapshotElement record;
+      std::memcpy(&record, base + elementsOffset + i * sizeof(SnapshotElement), sizeof(record));
+
+      std::optional<std::string_view> const name = FromSnapshotView(record.name, text);
+      std::optional<std::string_view> const content = FromSnapshotView(record.content, text);
+      bool const linksForward = (record.parent == XMLElement::INVALID_INDEX || record.parent < i) &&
+                                (record.firstChild == XMLElement::INVALID_INDEX || (record.firstChild > i && record.firstChild < nrOfElements)) &&
+                                (record.nextSibling == XMLElement::INVALID_INDEX || (record.nextSibling > i && record.nextSibling < nrOfElements));
+      if (!name.has_value() || !content.has_value() || !linksForward || record.attributeOffset > header.nrOfAttributes ||
+          record.attributeCount > header.nrOfAttributes - record.attributeOffset)
+      {
+        return std::unexpected{InvalidSnapshot(snapshotPath, std::format("element {} is damaged", i))};
+      }
+
+      XMLElement& element = elements.emplace_back(XMLElement{*name, record.attributeOffset, record.attributeCount});
+      element.m_rawContent = *content;
+      element.m_parent = record.parent;
+      element.m_firstChild = record.firstChild;
+      element.m_nextSibling = record.nextSibling;
+    }
+
+    std::pmr::vector<XMLAttribute> attributes{resource};
+    attributes.reserve(header.nrOfAttributes);
+    for (size_t i{}; i < header.nrOfAttributes; ++i)
+    {
+      SnapshotAttribute record;
+      std::memcpy(&record, base + attributesOffset + i * sizeof(SnapshotAttribute), sizeof(record));
+
+      std::optional<std::string_view> const key = FromSnapshotView(record.key, text);
+      std::optional<std::string_view> const value = FromSnapshotView(record.value, text);
+      if (!key.has_value() || !value.has_value())
+      {
+        return std::unexpected{InvalidSnapshot(snapshotPath, std::format("attribute {} is damaged", i))};
+      }
+
+      attributes.push_back(XMLAttribute{*key, *value});
+    }
+
+    XMLDocument document{std::move(elements), std::move(attributes)};
+    document.m_source = std::move(source);
+    return document;
+  }
+
+  std::expected<XMLDocument, XMLError> XMLSnapshot::LoadOrParse(std::string_view sourcePath, std::string_view snapshotPath, ParseOptions const& options)
+  {
+    CHECK_EXPECTED_NO_TRANSFORM(size_t, size, GetFileSize(sourcePath));
+
+    // A snapshot does not record the filter it was made with, so filtered parses neither load nor write one
+    if (size == 0 || !options.filter.empty())
+    {
+      return XMLParser{options}.Parse(sourcePath);
+    }
+
+    CHECK_EXPECTED_NO_TRANSFORM(void*, view, MapFile(sourcePath, size, MemoryMap{}));
+    XMLSource source{static_cast<char const*>(view), size, [](char const* data, size_t dataSize) { UnmapFile(const_cast<char*>(data), dataSize); }};
+
+    if (auto snapshot = Load(snapshotPath, size, Checksum(source.GetText()), options.memoryResource); snapshot.has_value())
+    {
+      if (options.buildIndex)
+      {
+        snapshot.value().BuildIndex();
+      }
+      return snapshot;
+    }
+
+    // Missing, stale or damaged, the source gets parsed after all
+    auto parsed = XMLParser{options}.ParseFromMemory(source.GetText());
+    if (!parsed.has_value())
+    {
+      return parsed;
+    }
+    parsed.value().m_source = std::move(source);
+
+    // Without a new snapshot the next start-up parses again, that is all a failure here costs
+    [[maybe_unused]] auto const written = Write(parsed.value(), snapshotPath);
+
+    return parsed;
+  }
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <expected>
+#include <format>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "FXML.h"
+#include "FXMLUtils.h"
+
+// Returns 'false' from a token parse function when the token runs past the end of a chunk which is not the last one,
+// so the caller can come back once more input is available. On the last chunk a missing terminator is an error
+#define CHECK_FOUND_OR_NEED_MORE(name, expected, finalChunk, errorMsg) \
+  size_t name;                                                         \
+  if (auto const res = (expected); !res)                               \
+  {                                                                    \
+    if (!(finalChunk))                                                 \
+    {                                                                  \
+      return false;                                                    \
+    }                                                                  \
+    return std::unexpected{XMLError{res.error(), errorMsg}};           \
+  }                                                                    \
+  else                                                                 \
+  {                                                                    \
+    name = res.value();                                                \
+  }
+
+namespace fxml
+{
+  /*
+  The tokenizer shared by every parsing front-end, it only lexes and leaves the tree building to 'Handler':
+
+    auto& GetAttributeStorage();  // vector the attributes of a start tag get appended to
+    bool HasOpenElement() const;
+    std::expected<void, XMLError> OnStartTag(std::string_view name, std::span<XMLAttribute const> attributes, bool isEmptyElement);
+    std::expected<void, XMLError> OnEndTag(std::string_view name);
+    std::expected<void, XMLError> OnContent(std::string_view content);
+    std::expected<void, XMLError> OnComment(std::string_view comment);
+
+  A handler may provide 'OnRawStartTag(std::string_view name, std::string_view rawTag, bool isEmptyElement)' instead of
+  'GetAttributeStorage' and 'OnStartTag', the attributes are then left for the handler to lex whenever it needs them
+
+  Input may arrive in chunks, a token which is cut off by the end of a chunk is left for the next call
+  */
+  template <typename Handler>
+  class Tokenizer
+  {
+   private:
+    Handler& m_handler;
+
+   public:
+    explicit Tokenizer(Handler& handler)
+      : m_handler(handler)
+    {
+    }
+
+    // Parses every complete token in 'buffer' from 'bufferPointer' on, 'bufferPointer' is left at the first token that was not parsed
+    std::expected<void, XMLError> ParseDocument(std::string_view const buffer, size_t& bufferPointer, bool finalChunk = true)
+    {
+      while (true)
+      {
+        CHECK_EXPECTED_NO_TRANSFORM(bool, parsed, ParseToken(buffer, bufferPointer, finalChunk));
+        if (!parsed)
+        {
+          RETURN_OK();
+        }
+      }
+    }
+
+    // Parses a single token, returns false if there is no complete token left in 'buffer'
+    std::expected<bool, XMLError> ParseToken(std::string_view const buffer, size_t& bufferPointer, bool finalChunk = true)
+    {
+      size_t const bufferSize = buffer.size();
+      while (bufferPointer < bufferSize && std::isspace(static_cast<unsigned char>(buffer[bufferPointer])))
+      {
+        ++bufferPointer;
+      }
+
+      // Trailing whitespace, nothing left to parse. Reading past the end is not an option, a mapping is not null-terminated
+      if (bufferPointer == bufferSize)
+      {
+        return false;
+      }
+
+      // Need two characters to tell the kind of token apart
+      if (!finalChunk && bufferSize - bufferPointer < 2)
+      {
+        return false;
+      }
+
+      std::string_view const start = buffer.substr(bufferPointer, 2);
+      if (start == "<!")
+      {
+        // Too few characters left to tell a CDATA section from a comment
+        std::string_view const markup = buffer.substr(bufferPointer, detail::CDATA_START.size());
+        if (!finalChunk && markup.size() < detail::CDATA_START.size() && detail::CDATA_START.starts_with(markup))
+        {
+          return false;
+        }
+
+        if (markup == detail::CDATA_START)
+        {
+          if (!m_handler.HasOpenElement())
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Trying to parse content when no start tag was parsed"}};
+          }
+
+          return ParseCData(buffer, bufferPointer, finalChunk);
+        }
+
+        return ParseComment(buffer, bufferPointer, finalChunk);
+      }
+      else if (start == "<?")
+      {
+        return ParseProcessingInstruction(buffer, bufferPointer, finalChunk);
+      }
+      else if (start == "</")
+      {
+        if (!m_handler.HasOpenElement())
+        {
+          return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag reached while no start tag was parsed"}};
+        }
+
+        return ParseEndTag(buffer, bufferPointer, finalChunk);
+      }
+      else if (start[0] == '<')
+      {
+        return ParseStartTag(buffer, bufferPointer, finalChunk);
+      }
+
+      if (!m_handler.HasOpenElement())
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Trying to parse content when no start tag was parsed"}};
+      }
+
+      return ParseContent(buffer, bufferPointer, finalChunk);
+    }
+
+   private:
+    std::expected<bool, XMLError> ParseStartTag(std::string_view const buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      // Tags must start with <
+      if (SafeAccess(buffer, bufferPointer) != '<')
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Expected <"}};
+      }
+
+      auto const notClosed = [finalChunk]() -> std::expected<bool, XMLError>
+      {
+        if (!finalChunk)
+        {
+          return false;
+        }
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Could not find closing bracket of start tag"}};
+      };
+
+      // A single forward pass: the name, every attribute and then the '/>' or '>', no byte of the tag gets looked at twice
+      size_t const nameEnd = FindFirstOf(buffer, NAME_END_CHARS, bufferPointer + 1);
+      if (nameEnd == std::string_view::npos)
+      {
+        return notClosed();
+      }
+
+      std::string_view const tagName = buffer.substr(bufferPointer + 1, nameEnd - bufferPointer - 1);
+      if (tagName.empty())
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Start tag is malformed"}};
+      }
+
+      // Handlers which only look at attributes on demand get the raw tag, attributes are not lexed up front
+      if constexpr (requires(std::string_view view, bool flag) { m_handler.OnRawStartTag(view, view, flag); })
+      {
+        auto const tagEnd = SafeFindTagEnd(buffer, nameEnd);
+        if (!tagEnd.has_value())
+        {
+          return notClosed();
+        }
+
+        CHECK_EXPECTED_VOID(m_handler.OnRawStartTag(tagName, buffer.substr(bufferPointer, *tagEnd - bufferPointer + 1), buffer[*tagEnd - 1] == '/'));
+
+        bufferPointer = *tagEnd + 1;
+      }
+      else
+      {
+        auto& attributes = m_handler.GetAttributeStorage();
+        size_t const attributeOffset = attributes.size();
+
+        // One bit per key, hashed on its length and last byte. Only keys which share a bit get compared
+        uint64_t keyBits{};
+
+        size_t offset{nameEnd};
+        while (true)
+        {
+          auto const attribute = NextAttribute(buffer, offset);
+          if (!attribute.has_value())
+          {
+            if (attribute.error() == ErrorReason::BUFFER_TOO_SMALL)
+            {
+              attributes.resize(attributeOffset);
+              return notClosed();
+            }
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Attribute in tag '{}' is malformed", tagName)}};
+          }
+          if (!attribute->has_value())
+          {
+            break;
+          }
+
+          std::string_view const key = (*attribute)->key;
+          uint64_t const keyBit = uint64_t{1} << ((key.size() * 7 + static_cast<uint8_t>(key.back())) & 63);
+          if ((keyBits & keyBit) != 0 && std::ranges::any_of(std::span{attributes}.subspan(attributeOffset),
+                                                              [key](XMLAttribute const& other) { return other.key == key; }))
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, std::format("Attribute key '{}' already present in tag '{}'", key, tagName)}};
+          }
+          keyBits |= keyBit;
+
+          attributes.push_back(**attribute);
+        }
+
+        // 'offset' is on the '/' of '/>' or on the '>'
+        bool const isEmptyElement = buffer[offset] == '/';
+        if (isEmptyElement)
+        {
+          if (offset + 1 == buffer.size())
+          {
+            attributes.resize(attributeOffset);
+            return notClosed();
+          }
+          if (buffer[offset + 1] != '>')
+          {
+            return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "Start tag is not properly closed"}};
+          }
+        }
+
+        CHECK_EXPECTED_VOID(m_handler.OnStartTag(tagName, std::span<XMLAttribute const>{attributes}.subspan(attributeOffset), isEmptyElement));
+
+        bufferPointer = offset + (isEmptyElement ? 2 : 1);
+      }
+
+      return true;
+    }
+
+    std::expected<bool, XMLError> ParseEndTag(std::string_view buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      if (SafeAccess(buffer, bufferPointer) != '<')
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag must start with '</'"}};
+      }
+
+      // Our 'rawTag' will look like </NAME
+      CHECK_FOUND_OR_NEED_MORE(pos, SafeFind(buffer, '>', bufferPointer + 1), finalChunk, "End tag closing bracket could not be found");
+      std::string_view const rawTag = buffer.substr(bufferPointer, pos - bufferPointer);
+
+      if (SafeAccess(buffer, bufferPointer + 1) != '/')
+      {
+        return std::unexpected{XMLError{ErrorReason::PARSE_ERROR, "End tag must start with '</'"}};
+      }
+
+      CHECK_EXPECTED_VOID(m_handler.OnEndTag(TrimTrailingWhitespace(rawTag.substr(2))));
+
+      bufferPointer += rawTag.size() + 1;  // + 1 because 'rawTag' does not have the closing bracket
+
+      return true;
+    }
+
+    std::expected<bool, XMLError> ParseContent(std::string_view buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      // Search until the next node
+      CHECK_FOUND_OR_NEED_MORE(pos, SafeFind(buffer, '<', bufferPointer + 1), finalChunk, "No end tag found for content");
+
+      std::string_view const content = buffer.substr(bufferPointer, pos - bufferPointer);
+      CHECK_EXPECTED_VOID(m_handler.OnContent(content));
+
+      bufferPointer += content.size();
+
+      return true;
+    }
+
+    std::expected<bool, XMLError> ParseComment(std::string_view buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      // Search until the end of the comment
+      CHECK_FOUND_OR_NEED_MORE(end, SafeFind(buffer, "-->", bufferPointer + 1), finalChunk, "Comment is not closed");
+
+      // + 3 for '-->'
+      std::string_view const comment = buffer.substr(bufferPointer, end - bufferPointer + 3);
+      CHECK_EXPECTED_VOID(m_handler.OnComment(comment));
+
+      bufferPointer += comment.size();
+
+      return true;
+    }
+
+    // The text of a CDATA section is handed over as content, without the markers around it
+    std::expected<bool, XMLError> ParseCData(std::string_view buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      size_t const textStart = bufferPointer + CDATA_START.size();
+      CHECK_FOUND_OR_NEED_MORE(end, SafeFind(buffer, CDATA_END, textStart), finalChunk, "CDATA section is not closed");
+
+      CHECK_EXPECTED_VOID(m_handler.OnContent(buffer.substr(textStart, end - textStart)));
+
+      bufferPointer = end + CDATA_END.size();
+
+      return true;
+    }
+
+    // '<?xml version="1.0"?>' and friends carry nothing the document needs, they are skipped
+    std::expected<bool, XMLError> ParseProcessingInstruction(std::string_view buffer, size_t& bufferPointer, bool finalChunk)
+    {
+      using namespace detail;
+
+      CHECK_FOUND_OR_NEED_MORE(end, SafeFind(buffer, "?>", bufferPointer + 2), finalChunk, "Processing instruction is not closed");
+
+      bufferPointer = end + 2;
+
+      return true;
+    }
+  };
+}  // namespace fxml
\ No newline at end of file
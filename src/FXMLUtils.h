@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "FXML.h"
+#include "FXMLScanner.h"
+
+#if defined(__GNUC__) || defined(__GNUG__)
+#define FORCE_INLINE __attribute__((always_inline)) inline
+#elif defined(_MSC_VER)
+#define FORCE_INLINE __forceinline
+#endif
+
+#define CHECK_EXPECTED_VOID(expected)    \
+  if (auto const res = (expected); !res) \
+  {                                      \
+    return std::unexpected{res.error()}; \
+  }
+#define CHECK_EXPECTED(type, name, expected, errorMsg)       \
+  type name;                                                 \
+  if (auto const res = (expected); !res)                     \
+  {                                                          \
+    return std::unexpected{XMLError{res.error(), errorMsg}}; \
+  }                                                          \
+  else                                                       \
+  {                                                          \
+    name = res.value();                                      \
+  }
+#define CHECK_EXPECTED_NO_TRANSFORM(type, name, expected) \
+  type name;                                              \
+  if (auto const res = (expected); !res)                  \
+  {                                                       \
+    return std::unexpected{res.error()};                  \
+  }                                                       \
+  else                                                    \
+  {                                                       \
+    name = res.value();                                   \
+  }
+#define RETURN_OK() \
+  return std::expected<void, XMLError> {}
+
+// Statements which only exist in instrumented builds
+#if FXML_ENABLE_INSTRUMENTATION
+#define FXML_INSTRUMENT(statement) statement
+#else
+#define FXML_INSTRUMENT(statement)
+#endif
+
+// Shared scanning primitives of the DOM parser, the SAX parser and the reader
+namespace fxml
+{
+  namespace detail
+  {
+    struct OnExitScope
+    {
+      std::function<void()> onExit;
+
+      ~OnExitScope()
+      {
+        onExit();
+      }
+    };
+
+#if FXML_ENABLE_INSTRUMENTATION
+    // Adds the time between construction and Stop() or destruction to 'total'
+    class ScopedTimer
+    {
+     private:
+      std::chrono::nanoseconds* m_total;
+      std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+     public:
+      explicit ScopedTimer(std::chrono::nanoseconds& total)
+        : m_total(&total)
+      {
+      }
+      ScopedTimer(ScopedTimer const&) = delete;
+      ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+      ~ScopedTimer()
+      {
+        Stop();
+      }
+
+      void Stop()
+      {
+        if (m_total)
+        {
+          *m_total += std::chrono::steady_clock::now() - m_start;
+          m_total = nullptr;
+        }
+      }
+    };
+#endif
+
+    inline std::expected<size_t, XMLError> GetFileSize(std::string_view filepath)
+    {
+      std::error_code ec;
+      size_t const size = std::filesystem::file_size(filepath, ec);
+
+      if (ec)
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_FIND_FILE, std::format("Cannot get file size of {}", filepath)}};
+      }
+
+      return size;
+    }
+
+    inline std::expected<std::filesystem::file_time_type, XMLError> GetLastWriteTime(std::string_view filepath)
+    {
+      std::error_code ec;
+      std::filesystem::file_time_type const time = std::filesystem::last_write_time(filepath, ec);
+
+      if (ec)
+      {
+        return std::unexpected{XMLError{ErrorReason::CANNOT_FIND_FILE, std::format("Cannot get last write time of {}", filepath)}};
+      }
+
+      return time;
+    }
+
+    // Read-only mapping of the first 'size' bytes of a file, 'size' must not be 0
+    std::expected<void*, XMLError> MapFile(std::string_view filepath, size_t size, MemoryMap const& options);
+    void UnmapFile(void* view, size_t size);
+
+    inline constexpr std::string_view CDATA_START{"<![CDATA["};
+    inline constexpr std::string_view CDATA_END{"]]>"};
+
+    // Ends tag names as well as attribute keys
+    inline constexpr CharSet NAME_END_CHARS{'=', '>', '/', ' ', '\t', '\n', '\r'};
+    inline constexpr CharSet TAG_END_OR_QUOTE_CHARS{'>', '"', '\''};
+
+    // Single pass over 'buffer', no matter how many characters are being searched for
+    FORCE_INLINE std::pair<size_t, char> FindFirstChar(std::string_view const buffer, CharSet const& chars, size_t offset = 0)
+    {
+      size_t const pos = FindFirstOf(buffer, chars, offset);
+      return {pos, pos == std::string_view::npos ? '\0' : buffer[pos]};
+    }
+
+    // std::string_view TrimWhitespace(std::string_view str)
+    // {
+    //   size_t const strBegin{str.find_first_not_of(" \t")};
+    //   if (strBegin == std::string_view::npos)
+    //   {
+    //     return "";
+    //   }
+
+    //   size_t const strEnd{str.find_last_not_of(" \t")};
+    //   return str.substr(strBegin, strEnd - strBegin + 1);
+    // }
+
+    FORCE_INLINE std::expected<char, ErrorReason> SafeAccess(std::string_view str, size_t index)
+    {
+      if (index >= str.size()) return std::unexpected{ErrorReason::PARSE_ERROR};
+      return str[index];
+    }
+
+    FORCE_INLINE std::expected<size_t, ErrorReason> SafeFind(std::string_view str, char c, size_t offset = 0)
+    {
+      size_t const pos = str.find(c, offset);
+      if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
+      return pos;
+    }
+
+    FORCE_INLINE std::expected<size_t, ErrorReason> SafeFind(std::string_view str, std::string_view toFind, size_t offset = 0)
+    {
+      size_t const pos = str.find(toFind, offset);
+      if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
+      return pos;
+    }
+
+    // FORCE_INLINE std::expected<size_t, ErrorReason> SafeFindList(std::string_view str, std::initializer_list<std::string_view> list, size_t offset = 0)
+    // {
+    //   size_t pos = std::string_view::npos;
+    //   for (std::string_view toFind : list)
+    //   {
+    //     size_t const found = str.find(toFind, offset);
+    //     pos = std::min(found, pos);
+    //   }
+    //   if (pos == std::string_view::npos) return std::unexpected{ErrorReason::PARSE_ERROR};
+    //   return pos;
+    // }
+
+    // Position of the '>' which closes the tag that 'offset' is in, a '>' inside a quoted attribute value does not close anything
+    inline std::expected<size_t, ErrorReason> SafeFindTagEnd(std::string_view buffer, size_t offset)
+    {
+      while (true)
+      {
+        size_t const pos = FindFirstOf(buffer, TAG_END_OR_QUOTE_CHARS, offset);
+        if (pos == std::string_view::npos)
+        {
+          return std::unexpected{ErrorReason::PARSE_ERROR};
+        }
+        if (buffer[pos] == '>')
+        {
+          return pos;
+        }
+
+        size_t const quoteEnd = buffer.find(buffer[pos], pos + 1);
+        if (quoteEnd == std::string_view::npos)
+        {
+          return std::unexpected{ErrorReason::PARSE_ERROR};
+        }
+        offset = quoteEnd + 1;
+      }
+    }
+
+    /*
+    Lexes the attribute at 'offset' in a single forward pass, 'offset' sits right behind the tag name or the previous attribute
+    Whitespace around the '=' and single-quoted values are fine. Returns std::nullopt once the tag ends, 'offset' is then left on its '/' or '>'
+    Running into the end of 'buffer' is ErrorReason::BUFFER_TOO_SMALL, so a caller with more input on the way can come back once it is there
+    */
+    inline std::expected<std::optional<XMLAttribute>, ErrorReason> NextAttribute(std::string_view buffer, size_t& offset)
+    {
+      size_t pos{offset};
+      auto const skipWhitespace = [buffer, &pos]()
+      {
+        while (pos < buffer.size() && WHITESPACE_CHARS.Contains(buffer[pos]))
+        {
+          ++pos;
+        }
+        return pos < buffer.size();
+      };
+
+      // Attributes are separated from the name and from each other by whitespace
+      bool const separated = pos < buffer.size() && WHITESPACE_CHARS.Contains(buffer[pos]);
+      if (!skipWhitespace())
+      {
+        return std::unexpected{ErrorReason::BUFFER_TOO_SMALL};
+      }
+      if (buffer[pos] == '/' || buffer[pos] == '>')
+      {
+        offset = pos;
+        return std::nullopt;
+      }
+      if (!separated)
+      {
+        return std::unexpected{ErrorReason::PARSE_ERROR};
+      }
+
+      // Keys are a handful of bytes, a table lookup per byte beats setting up a vector search
+      size_t const keyStart{pos};
+      while (pos < buffer.size() && !NAME_END_CHARS.Contains(buffer[pos]))
+      {
+        ++pos;
+      }
+      std::string_view const key = buffer.substr(keyStart, pos - keyStart);
+
+      if (!skipWhitespace())
+      {
+        return std::unexpected{ErrorReason::BUFFER_TOO_SMALL};
+      }
+      if (key.empty() || buffer[pos] != '=')
+      {
+        return std::unexpected{ErrorReason::PARSE_ERROR};
+      }
+
+      ++pos;
+      if (!skipWhitespace())
+      {
+        return std::unexpected{ErrorReason::BUFFER_TOO_SMALL};
+      }
+
+      char const quote = buffer[pos];
+      if (quote != '"' && quote != '\'')
+      {
+        return std::unexpected{ErrorReason::PARSE_ERROR};
+      }
+
+      // An '=' or '>' inside the value is part of the value
+      size_t const valueEnd = buffer.find(quote, pos + 1);
+      if (valueEnd == std::string_view::npos)
+      {
+        return std::unexpected{ErrorReason::BUFFER_TOO_SMALL};
+      }
+
+      offset = valueEnd + 1;
+      return XMLAttribute{key, buffer.substr(pos + 1, valueEnd - pos - 1)};
+    }
+
+    inline constexpr CharSet REFERENCE_START_CHARS{'&'};
+
+    // 'content' must be a content view handed out by the tokenizer. Text from a CDATA section starts right behind the '<![CDATA[' marker,
+    // other content starts after a '>' or whitespace
+    inline bool IsCDataText(std::string_view content)
+    {
+      return !content.empty() && content.data()[-1] == CDATA_START.back();
+    }
+
+    template <typename String>
+    void AppendUtf8(uint32_t codePoint, String& out)
+    {
+      if (codePoint < 0x80)
+      {
+        out.push_back(static_cast<char>(codePoint));
+      }
+      else if (codePoint < 0x800)
+      {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+      else if (codePoint < 0x10000)
+      {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+      else
+      {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+      }
+    }
+
+    // 'reference' is whatever sits between '&' and ';', returns false if it is not a reference we know
+    template <typename String>
+    bool AppendReference(std::string_view reference, String& out)
+    {
+      if (reference.starts_with('#'))
+      {
+        bool const hex = reference.size() > 1 && (reference[1] == 'x' || reference[1] == 'X');
+        std::string_view const digits = reference.substr(hex ? 2 : 1);
+
+        uint32_t codePoint{};
+        auto const [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), codePoint, hex ? 16 : 10);
+        bool const isSurrogate = codePoint >= 0xD800 && codePoint <= 0xDFFF;
+        if (digits.empty() || ec != std::errc{} || end != digits.data() + digits.size() || codePoint == 0 || codePoint > 0x10FFFF || isSurrogate)
+        {
+          return false;
+        }
+
+        AppendUtf8(codePoint, out);
+        return true;
+      }
+
+      constexpr std::pair<std::string_view, char> PREDEFINED_ENTITIES[] = {{"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}};
+      for (auto const& [name, c] : PREDEFINED_ENTITIES)
+      {
+        if (reference == name)
+        {
+          out.push_back(c);
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    // Appends 'raw' to 'out' with every entity and character reference replaced, anything which is not a valid reference is kept as is
+    template <typename String>
+    void DecodeReferences(std::string_view raw, String& out)
+    {
+      size_t pos{};
+      while (pos < raw.size())
+      {
+        size_t const ampersand = FindFirstOf(raw, REFERENCE_START_CHARS, pos);
+        if (ampersand == std::string_view::npos)
+        {
+          out.append(raw.substr(pos));
+          return;
+        }
+        out.append(raw.substr(pos, ampersand - pos));
+
+        size_t const semicolon = raw.find(';', ampersand + 1);
+        if (semicolon == std::string_view::npos)
+        {
+          out.append(raw.substr(ampersand));
+          return;
+        }
+
+        if (!AppendReference(raw.substr(ampersand + 1, semicolon - ampersand - 1), out))
+        {
+          out.append(raw.substr(ampersand, semicolon - ampersand + 1));
+        }
+        pos = semicolon + 1;
+      }
+    }
+
+    inline std::string_view TrimTrailingWhitespace(std::string_view str)
+    {
+      while (!str.empty() && WHITESPACE_CHARS.Contains(str.back()))
+      {
+        str.remove_suffix(1);
+      }
+
+      return str;
+    }
+  }  // namespace detail
+}  // namespace fxml
\ No newline at end of file
@@ -0,0 +1,494 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "FXML.h"
+#include "FXMLArena.h"
+#include "FXMLCorpus.h"
+#include "FXMLQuery.h"
+#include "FXMLReader.h"
+#include "FXMLSax.h"
+#include "FXMLSnapshot.h"
+
+// Every allocation in the process goes through here, so the benchmarks can report allocations per node
+namespace
+{
+  std::atomic<size_t> g_nrOfAllocations{0};
+}
+
+void* operator new(size_t size)
+{
+  g_nrOfAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size > 0 ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  using namespace fxml;
+
+  constexpr size_t MiB = 1024 * 1024;
+  constexpr size_t LARGE_CORPUS_SIZE = 128 * MiB;
+
+  // Generating the large documents takes longer than parsing them, every corpus is generated once per process
+  std::string const& GetCorpus(CorpusKind kind, size_t size)
+  {
+    static std::map<std::pair<CorpusKind, size_t>, std::string> corpora;
+
+    auto it = corpora.find({kind, size});
+    if (it == corpora.end())
+    {
+      it = corpora.emplace(std::pair{kind, size}, GenerateCorpus(kind, size)).first;
+    }
+    return it->second;
+  }
+
+  std::string const& GetCorpusFile(CorpusKind kind, size_t size)
+  {
+    static std::map<std::pair<CorpusKind, size_t>, std::string> files;
+
+    auto it = files.find({kind, size});
+    if (it == files.end())
+    {
+      std::string const path = (std::filesystem::temp_directory_path() / std::format("fxml_bench_{}_{}.xml", GetCorpusName(kind), size)).string();
+      std::string const& corpus = GetCorpus(kind, size);
+      std::ofstream{path, std::ios::binary}.write(corpus.data(), static_cast<std::streamsize>(corpus.size()));
+      it = files.emplace(std::pair{kind, size}, path).first;
+    }
+    return it->second;
+  }
+
+  XMLDocument ParseOrSkip(benchmark::State& state, std::string const& corpus)
+  {
+    auto result = XMLParser{}.ParseFromMemory(corpus);
+    if (!result)
+    {
+      state.SkipWithError(result.error().what().c_str());
+      return {};
+    }
+    return std::move(result.value());
+  }
+
+  // Counts allocations from construction until Report, lookups and traversals pass 0 bytes since they do not go through the text
+  class AllocationCounter
+  {
+   private:
+    size_t m_start = g_nrOfAllocations.load(std::memory_order_relaxed);
+
+   public:
+    void Report(benchmark::State& state, size_t bytesPerIteration, size_t nodesPerIteration) const
+    {
+      size_t const allocations = g_nrOfAllocations.load(std::memory_order_relaxed) - m_start;
+      double const nodes = static_cast<double>(state.iterations()) * static_cast<double>(nodesPerIteration);
+
+      if (bytesPerIteration > 0)
+      {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytesPerIteration));
+      }
+      state.counters["nodes/s"] = benchmark::Counter(nodes, benchmark::Counter::kIsRate);
+      state.counters["allocs/node"] = nodes > 0 ? static_cast<double>(allocations) / nodes : 0.0;
+    }
+  };
+
+  // ===============================
+  // ============ PARSE ============
+  // ===============================
+  void BM_Parse(benchmark::State& state, CorpusKind kind)
+  {
+    std::string const& corpus = GetCorpus(kind, static_cast<size_t>(state.range(0)));
+    size_t const nrOfNodes = ParseOrSkip(state, corpus).GetNrOfNodes();
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto result = XMLParser{}.ParseFromMemory(corpus);
+      benchmark::DoNotOptimize(result);
+    }
+    counter.Report(state, corpus.size(), nrOfNodes);
+    state.SetComplexityN(state.range(0));
+  }
+
+  // One parser and one arena for every iteration, the steady state of a server parsing request after request
+  void BM_ParseReused(benchmark::State& state, CorpusKind kind)
+  {
+    std::string const& corpus = GetCorpus(kind, static_cast<size_t>(state.range(0)));
+    size_t const nrOfNodes = ParseOrSkip(state, corpus).GetNrOfNodes();
+
+    XMLArena arena;
+    ParseOptions options;
+    options.memoryResource = &arena;
+    XMLParser parser{options};
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      {
+        auto result = parser.ParseFromMemory(corpus);
+        benchmark::DoNotOptimize(result);
+      }
+      arena.Reset();
+    }
+    counter.Report(state, corpus.size(), nrOfNodes);
+  }
+
+  enum class LoadMode
+  {
+    READ,
+    MEMORY_MAP,
+    ASYNC_READ
+  };
+
+  void BM_ParseFile(benchmark::State& state, LoadMode mode)
+  {
+    std::string const& path = GetCorpusFile(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    size_t const nrOfNodes = ParseOrSkip(state, GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)))).GetNrOfNodes();
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto result = mode == LoadMode::MEMORY_MAP   ? XMLParser{}.Parse(path, MemoryMap{})
+                    : mode == LoadMode::ASYNC_READ ? XMLParser{}.Parse(path, AsyncRead{})
+                                                   : XMLParser{}.Parse(path);
+      benchmark::DoNotOptimize(result);
+    }
+    counter.Report(state, std::filesystem::file_size(path), nrOfNodes);
+  }
+
+  // Start-up with a snapshot that still matches, checksumming the source included
+  void BM_LoadSnapshot(benchmark::State& state)
+  {
+    std::string const& path = GetCorpusFile(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    std::string const snapshotPath = path + ".fxmls";
+    auto result = XMLSnapshot::LoadOrParse(path, snapshotPath);
+    if (!result)
+    {
+      state.SkipWithError(result.error().what().c_str());
+      return;
+    }
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto loaded = XMLSnapshot::LoadOrParse(path, snapshotPath);
+      benchmark::DoNotOptimize(loaded);
+    }
+    counter.Report(state, std::filesystem::file_size(path), result.value().GetNrOfNodes());
+  }
+
+  void BM_ParseParallel(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, LARGE_CORPUS_SIZE);
+    size_t const nrOfNodes = ParseOrSkip(state, corpus).GetNrOfNodes();
+
+    ParseOptions options;
+    options.threadCount = static_cast<uint32_t>(state.range(0));
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto result = XMLParser{options}.ParseFromMemory(corpus);
+      benchmark::DoNotOptimize(result);
+    }
+    counter.Report(state, corpus.size(), nrOfNodes);
+  }
+
+  // One small element out of every record, the rest is only scanned for tag boundaries
+  void BM_ParseFiltered(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+
+    ParseOptions options;
+    options.filter = {"/corpus/record/price"};
+    XMLParser parser{options};
+
+    size_t nrOfNodes{};
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto result = parser.ParseFromMemory(corpus);
+      nrOfNodes = result ? result->GetNrOfNodes() : 0;
+      benchmark::DoNotOptimize(result);
+    }
+    counter.Report(state, corpus.size(), nrOfNodes);
+  }
+
+  void BM_SaxParse(benchmark::State& state, CorpusKind kind)
+  {
+    struct CountingHandler : XMLSaxHandler
+    {
+      size_t nrOfElements{};
+
+      std::expected<void, XMLError> OnStartElement(std::string_view, XMLAttributes) override
+      {
+        ++nrOfElements;
+        return {};
+      }
+    };
+
+    std::string const& corpus = GetCorpus(kind, static_cast<size_t>(state.range(0)));
+
+    XMLSaxParser parser;
+    CountingHandler handler;
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      handler.nrOfElements = 0;
+      benchmark::DoNotOptimize(parser.ParseFromMemory(corpus, handler));
+    }
+    counter.Report(state, corpus.size(), handler.nrOfElements);
+  }
+
+  void BM_Reader(benchmark::State& state, CorpusKind kind)
+  {
+    std::string const& corpus = GetCorpus(kind, static_cast<size_t>(state.range(0)));
+
+    size_t nrOfElements{};
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      nrOfElements = 0;
+      XMLReader reader{corpus};
+      while (reader.Next().value_or(false))
+      {
+        nrOfElements += reader.Type() == XMLNodeType::START_ELEMENT;
+      }
+    }
+    counter.Report(state, corpus.size(), nrOfElements);
+  }
+
+  // An edit of one attribute value in the middle of the document, against parsing the whole edited text again
+  void BM_Reparse(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    XMLParser parser;
+    auto result = parser.ParseFromMemory(corpus);
+    if (!result)
+    {
+      state.SkipWithError(result.error().what().c_str());
+      return;
+    }
+    XMLDocument document{std::move(result.value())};
+
+    size_t const offset = corpus.find("type=\"", corpus.size() / 2) + 6;
+    if (!parser.Reparse(document, corpus, XMLEdit{offset, 0, ""}))
+    {
+      state.SkipWithError("Reparse failed");
+      return;
+    }
+
+    AllocationCounter counter;
+    bool toggle{};
+    for (auto _ : state)
+    {
+      toggle = !toggle;
+      benchmark::DoNotOptimize(parser.Reparse(document, toggle ? XMLEdit{offset, 1, "B"} : XMLEdit{offset, 1, "b"}));
+    }
+    counter.Report(state, corpus.size(), document.GetNrOfNodes());
+  }
+
+  // ===============================
+  // =========== LOOKUPS ===========
+  // ===============================
+
+  // Linear scan for a name which is not in the document, the worst case without an index
+  void BM_GetNodeByName(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::WIDE_FANOUT, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(document.GetNodeByName("missing"));
+    }
+    counter.Report(state, corpus.size(), document.GetNrOfNodes());
+  }
+
+  void BM_GetNodesByName(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+    document.BuildIndex();
+
+    size_t nrOfMatches{};
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      for (XMLElement const& element : document.GetNodesByName("price"))
+      {
+        benchmark::DoNotOptimize(element);
+        ++nrOfMatches;
+      }
+    }
+    counter.Report(state, 0, nrOfMatches / std::max<size_t>(state.iterations(), 1));
+  }
+
+  void BM_GetNodesByAttribute(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+    document.BuildIndex();
+
+    size_t nrOfMatches{};
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      for (XMLElement const& element : document.GetNodesByAttribute("type", "book"))
+      {
+        benchmark::DoNotOptimize(element);
+        ++nrOfMatches;
+      }
+    }
+    counter.Report(state, 0, nrOfMatches / std::max<size_t>(state.iterations(), 1));
+  }
+
+  void BM_BuildIndex(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    size_t const nrOfNodes = ParseOrSkip(state, corpus).GetNrOfNodes();
+
+    ParseOptions options;
+    options.buildIndex = true;
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      auto result = XMLParser{options}.ParseFromMemory(corpus);
+      benchmark::DoNotOptimize(result);
+    }
+    counter.Report(state, corpus.size(), nrOfNodes);
+  }
+
+  void BM_Query(benchmark::State& state, bool withIndex)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::MIXED, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+    if (withIndex)
+    {
+      document.BuildIndex();
+    }
+
+    auto const query = XMLQuery::Compile("//record[@type='book']/price");
+    if (!query)
+    {
+      state.SkipWithError(query.error().what().c_str());
+      return;
+    }
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(query->Count(document));
+    }
+    counter.Report(state, 0, document.GetNrOfNodes());
+  }
+
+  // ===============================
+  // ========== TRAVERSAL ==========
+  // ===============================
+  size_t VisitSubtree(XMLDocument const& document, XMLElement const& element)
+  {
+    size_t nrOfNodes{1};
+    for (XMLElement const& child : document.GetChildren(element))
+    {
+      nrOfNodes += VisitSubtree(document, child);
+    }
+    return nrOfNodes;
+  }
+
+  void BM_TraverseTree(benchmark::State& state, CorpusKind kind)
+  {
+    std::string const& corpus = GetCorpus(kind, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+    auto const root = document.GetRoot();
+    if (!root)
+    {
+      state.SkipWithError("Document has no root");
+      return;
+    }
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(VisitSubtree(document, *root));
+    }
+    counter.Report(state, 0, document.GetNrOfNodes());
+  }
+
+  void BM_DecodeContent(benchmark::State& state)
+  {
+    std::string const& corpus = GetCorpus(CorpusKind::TEXT_HEAVY, static_cast<size_t>(state.range(0)));
+    XMLDocument document = ParseOrSkip(state, corpus);
+
+    AllocationCounter counter;
+    for (auto _ : state)
+    {
+      for (uint32_t i{}; i < document.GetNrOfNodes(); ++i)
+      {
+        benchmark::DoNotOptimize(document.GetContent(document.GetNodeByIndex(i)->get()));
+      }
+    }
+    counter.Report(state, 0, document.GetNrOfNodes());
+  }
+}  // namespace
+
+// Document sizes are in bytes, the parse benchmarks also fit a complexity curve so a quadratic pass shows up as such
+#define FXML_CORPUS_BENCHMARK(func, kind) \
+  BENCHMARK_CAPTURE(func, kind, CorpusKind::kind)->RangeMultiplier(4)->Range(256 * 1024, 16 * MiB)->Unit(benchmark::kMillisecond)
+
+FXML_CORPUS_BENCHMARK(BM_Parse, DEEP_NESTING)->Complexity();
+FXML_CORPUS_BENCHMARK(BM_Parse, WIDE_FANOUT)->Complexity();
+FXML_CORPUS_BENCHMARK(BM_Parse, ATTRIBUTE_HEAVY)->Complexity();
+FXML_CORPUS_BENCHMARK(BM_Parse, TEXT_HEAVY)->Complexity();
+FXML_CORPUS_BENCHMARK(BM_Parse, COMMENT_HEAVY)->Complexity();
+FXML_CORPUS_BENCHMARK(BM_Parse, MIXED)->Complexity();
+BENCHMARK_CAPTURE(BM_Parse, LARGE, CorpusKind::MIXED)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond);
+
+FXML_CORPUS_BENCHMARK(BM_ParseReused, MIXED);
+BENCHMARK_CAPTURE(BM_ParseFile, Read, LoadMode::READ)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ParseFile, MemoryMap, LoadMode::MEMORY_MAP)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ParseFile, AsyncRead, LoadMode::ASYNC_READ)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LoadSnapshot)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseFiltered)->Arg(16 * MiB)->Arg(LARGE_CORPUS_SIZE)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseParallel)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_Reparse)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+
+FXML_CORPUS_BENCHMARK(BM_SaxParse, MIXED);
+FXML_CORPUS_BENCHMARK(BM_Reader, MIXED);
+
+BENCHMARK(BM_GetNodeByName)->Arg(16 * MiB)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetNodesByName)->Arg(16 * MiB)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetNodesByAttribute)->Arg(16 * MiB)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BuildIndex)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Query, Scan, false)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Query, Index, true)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_TraverseTree, DEEP_NESTING, CorpusKind::DEEP_NESTING)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseTree, WIDE_FANOUT, CorpusKind::WIDE_FANOUT)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TraverseTree, MIXED, CorpusKind::MIXED)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DecodeContent)->Arg(16 * MiB)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -1,14 +1,64 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <thread>
 
 #include "FXML.h"
+#include "FXMLArena.h"
+#include "FXMLBatch.h"
+#include "FXMLBinding.h"
+#include "FXMLCache.h"
+#include "FXMLCompressed.h"
+#include "FXMLQuery.h"
+#include "FXMLReader.h"
+#include "FXMLSax.h"
+#include "FXMLScanner.h"
+#include "FXMLSnapshot.h"
 
 std::string_view constexpr SIMPLE_DATA_FILEPATH = "test_data/simple_data.xml";
 std::array<std::string_view, 6> constexpr SIMPLE_DATA_NODE_NAMES = {"root", "node_one", "node_two", "name", "country", "node_three"};
 
 using namespace fxml;
 
+struct BoundServer
+{
+  std::string host;
+  uint16_t port = 0;
+};
+
+struct BoundConfig
+{
+  std::string name;
+  std::string_view rawName;
+  int version = 0;
+  double ratio = 0.0;
+  bool enabled = false;
+  BoundServer primary;
+  std::vector<BoundServer> servers;
+  std::vector<int> ids;
+};
+
+template <>
+struct fxml::XMLBinding<BoundServer>
+{
+  static constexpr std::string_view name = "server";
+  static constexpr auto fields = std::tuple{Attribute("host", &BoundServer::host), Element("port", &BoundServer::port)};
+};
+
+template <>
+struct fxml::XMLBinding<BoundConfig>
+{
+  static constexpr std::string_view name = "config";
+  static constexpr auto fields = std::tuple{Element("name", &BoundConfig::name),       Element("rawName", &BoundConfig::rawName),
+                                            Attribute("version", &BoundConfig::version), Element("ratio", &BoundConfig::ratio),
+                                            Element("enabled", &BoundConfig::enabled),  Element("primary", &BoundConfig::primary),
+                                            Element("server", &BoundConfig::servers),   Element("id", &BoundConfig::ids)};
+};
+
 struct FXMLTests : ::testing::Test
 {
   void SetUp() override {}
@@ -31,7 +81,7 @@ TEST_F(FXMLTests, testParseSimpleFile)
     std::cout << "Error: " << ret.error().what() << "\n";
   }
 
-  XMLDocument doc{ret.value()};
+  XMLDocument doc{std::move(ret.value())};
 
   // Check the Tags
   for (size_t i{}; i < doc.GetNrOfNodes(); ++i)
@@ -56,4 +106,1252 @@ TEST_F(FXMLTests, testParseSimpleFile)
   EXPECT_NO_THROW(EXPECT_EQ(doc.GetNodeByName("node_two").value().get().GetTag().attributes.at("another_attribute"), "Some Data"));
   EXPECT_TRUE(doc.GetNodeByName("node_three").value().get().GetTag().attributes.contains("city"));
   EXPECT_NO_THROW(EXPECT_EQ(doc.GetNodeByName("node_three").value().get().GetTag().attributes.at("city"), "Kortrijk"));
-}
\ No newline at end of file
+}
+
+TEST_F(FXMLTests, testParseSimpleFileMemoryMapped)
+{
+  for (bool const populate : {false, true})
+  {
+    XMLParser parser{};
+    auto ret = parser.Parse(SIMPLE_DATA_FILEPATH, MemoryMap{populate});
+    ASSERT_TRUE(ret.has_value());
+
+    XMLDocument doc{std::move(ret.value())};
+
+    ASSERT_EQ(doc.GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+    for (size_t i{}; i < doc.GetNrOfNodes(); ++i)
+    {
+      EXPECT_EQ(doc.GetNodeByIndex(i).value().get().GetTag().name, SIMPLE_DATA_NODE_NAMES[i]);
+    }
+
+    EXPECT_EQ(doc.GetNodeByName("name").value().get().GetRawContent(), "Rhidian");
+    EXPECT_EQ(doc.GetNodeByName("node_three").value().get().GetTag().attributes.at("city"), "Kortrijk");
+  }
+
+  EXPECT_EQ(XMLParser{}.Parse("BlablaBla", MemoryMap{}).error().reason(), ErrorReason::CANNOT_FIND_FILE);
+}
+
+TEST_F(FXMLTests, testParseAsyncRead)
+{
+  std::string xml = "<?xml version=\"1.0\"?>\n<root>";
+  for (int i{}; i < 3000; ++i)
+  {
+    xml += std::format("<item id=\"{}\"><!-- <fake/> --><name>Item {}</name><![CDATA[<not a tag>]]><leaf/></item>\n", i, i);
+  }
+  xml += "</root>";
+
+  std::filesystem::path const path = std::filesystem::temp_directory_path() / "fxml_async_read_test.xml";
+  std::ofstream{path, std::ios::binary | std::ios::trunc} << xml;
+
+  auto const expected = XMLParser{}.ParseFromMemory(xml);
+  ASSERT_TRUE(expected.has_value()) << expected.error().what();
+
+  // Page-sized chunks cut through tokens all over the file, the tokenizer has to pick every one of them up again
+  for (size_t const chunkSize : {size_t{1}, size_t{64 * 1024}, size_t{1024 * 1024}})
+  {
+    auto const ret = XMLParser{}.Parse(path.string(), AsyncRead{chunkSize, 3});
+    ASSERT_TRUE(ret.has_value()) << ret.error().what();
+
+    XMLDocument const& doc = ret.value();
+    ASSERT_EQ(doc.GetNrOfNodes(), expected.value().GetNrOfNodes());
+    for (uint32_t i{}; i < doc.GetNrOfNodes(); ++i)
+    {
+      XMLElement const& lhs = expected.value().GetNodeByIndex(i).value();
+      XMLElement const& rhs = doc.GetNodeByIndex(i).value();
+      ASSERT_EQ(lhs.GetTag().name, rhs.GetTag().name);
+      ASSERT_EQ(lhs.GetRawContent(), rhs.GetRawContent());
+    }
+  }
+
+  ParseOptions options;
+  options.filter = {"//name"};
+  EXPECT_EQ(XMLParser{options}.Parse(path.string(), AsyncRead{1}).value().GetNrOfNodes(), 3000);
+
+  // An element left open is only noticed once the last chunk is in
+  std::ofstream{path, std::ios::binary | std::ios::trunc} << std::string_view{xml}.substr(0, xml.size() - std::string_view{"</root>"}.size());
+  auto const unclosed = XMLParser{}.Parse(path.string(), AsyncRead{1});
+  ASSERT_FALSE(unclosed.has_value());
+  EXPECT_EQ(unclosed.error().what(), "EOF reached while tag 'root' is still open");
+
+  std::ofstream{path, std::ios::binary | std::ios::trunc};
+  EXPECT_EQ(XMLParser{}.Parse(path.string(), AsyncRead{}).value().GetNrOfNodes(), 0);
+  std::filesystem::remove(path);
+
+  EXPECT_EQ(XMLParser{}.Parse("BlablaBla", AsyncRead{}).error().reason(), ErrorReason::CANNOT_FIND_FILE);
+}
+
+TEST_F(FXMLTests, testParseFromMemory)
+{
+  std::string const xml = "<root><child key=\"value\">Content</child><empty/></root>";
+
+  XMLParser parser{};
+  auto ret = parser.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+
+  XMLDocument doc{std::move(ret.value())};
+  ASSERT_EQ(doc.GetNrOfNodes(), 3);
+  EXPECT_EQ(doc.GetNodeByName("child").value().get().GetRawContent(), "Content");
+  EXPECT_EQ(doc.GetNodeByName("child").value().get().GetTag().attributes.at("key"), "value");
+
+  // Views must point straight into the caller's memory
+  std::string_view const content = doc.GetNodeByName("child").value().get().GetRawContent();
+  EXPECT_GE(content.data(), xml.data());
+  EXPECT_LT(content.data(), xml.data() + xml.size());
+
+  // Raw bytes go in as a view over them
+  std::vector<char> const bytes(xml.begin(), xml.end());
+  auto bytesRet = XMLParser{}.ParseFromMemory(std::string_view{bytes.data(), bytes.size()});
+  ASSERT_TRUE(bytesRet.has_value());
+  EXPECT_EQ(bytesRet.value().GetNrOfNodes(), 3);
+}
+
+TEST_F(FXMLTests, testScannerFindsStructuralChars)
+{
+  // Cover the 32-byte, 16-byte and scalar tail paths of whichever kernel is active
+  std::string text(100, 'a');
+  for (size_t i{}; i < text.size(); ++i)
+  {
+    text[i] = '<';
+    for (size_t offset : {size_t{0}, size_t{1}, size_t{17}, size_t{40}})
+    {
+      size_t const expected = offset <= i ? i : std::string_view::npos;
+      EXPECT_EQ(FindFirstOf(text, STRUCTURAL_CHARS, offset), expected);
+    }
+    text[i] = 'a';
+  }
+
+  EXPECT_EQ(FindFirstOf(text, STRUCTURAL_CHARS), std::string_view::npos);
+  EXPECT_EQ(FindFirstOf("name\tkey=\"value\"", STRUCTURAL_CHARS), 4);
+}
+
+TEST_F(FXMLTests, testParseStartTagVariants)
+{
+  std::string const xml = "<root>\n<empty/>\n<multi\n  first=\"1\"\n  url=\"a=b\"/>\n</root>";
+
+  XMLParser parser{};
+  auto ret = parser.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+
+  XMLDocument doc{std::move(ret.value())};
+  ASSERT_EQ(doc.GetNrOfNodes(), 3);
+  EXPECT_EQ(doc.GetNodeByIndex(1).value().get().GetTag().name, "empty");
+  EXPECT_EQ(doc.GetNodeByIndex(2).value().get().GetTag().name, "multi");
+
+  auto const& attributes = doc.GetNodeByName("multi").value().get().GetTag().attributes;
+  EXPECT_EQ(attributes.size(), 2);
+  EXPECT_EQ(attributes.at("first"), "1");
+  EXPECT_EQ(attributes.at("url"), "a=b");
+
+  // Single quotes, whitespace around '=' and a '>' inside a value
+  std::string const quoted = "<root a='1' b = \"it's\"\n c\t=\t'say \"hi\"' d=\"x>y\" e='/>'/>";
+  auto quotedRet = XMLParser{}.ParseFromMemory(quoted);
+  ASSERT_TRUE(quotedRet.has_value()) << quotedRet.error().what();
+  XMLAttributes const& quotedAttributes = quotedRet.value().GetRoot().value().get().GetTag().attributes;
+  ASSERT_EQ(quotedAttributes.size(), 5);
+  EXPECT_EQ(quotedAttributes.at("a"), "1");
+  EXPECT_EQ(quotedAttributes.at("b"), "it's");
+  EXPECT_EQ(quotedAttributes.at("c"), "say \"hi\"");
+  EXPECT_EQ(quotedAttributes.at("d"), "x>y");
+  EXPECT_EQ(quotedAttributes.at("e"), "/>");
+
+  XMLReader reader{quoted};
+  ASSERT_TRUE(reader.Next().value());
+  EXPECT_TRUE(reader.IsEmptyElement());
+  EXPECT_EQ(reader.Attributes().find("d"), "x>y");
+  EXPECT_FALSE(reader.Next().value());
+
+  for (std::string_view const malformed : {"<a b/>", "<a b=1/>", "<a b=\"1\"c=\"2\"/>", "<a =\"1\"/>", "<a b=\"1\" b='2'/>", "<a b=\"1/>", "<a / >"})
+  {
+    EXPECT_FALSE(XMLParser{}.ParseFromMemory(malformed).has_value()) << malformed;
+  }
+
+  // Many attributes, every duplicate is still caught whichever keys share a bit
+  std::string wide = "<a";
+  for (size_t i{}; i < 200; ++i)
+  {
+    wide += std::format(" k{}=\"{}\"", i, i);
+  }
+  EXPECT_EQ(XMLParser{}.ParseFromMemory(wide + "/>").value().GetRoot().value().get().GetTag().attributes.size(), 200);
+  EXPECT_FALSE(XMLParser{}.ParseFromMemory(wide + " k123=\"\"/>").has_value());
+}
+TEST_F(FXMLTests, testFlatAttributeStorage)
+{
+  std::string const xml = "<root a=\"1\" b=\"2\"><child c=\"3\"/><child/><child d=\"4\" e=\"5\"/></root>";
+
+  std::optional<XMLDocument> copy;
+  {
+    XMLParser parser{};
+    auto ret = parser.ParseFromMemory(xml);
+    ASSERT_TRUE(ret.has_value());
+
+    // The copy must point at its own attribute array, not at the one destroyed with 'ret'
+    copy = ret.value().Clone();
+  }
+
+  std::array<std::string_view, 5> constexpr keys = {"a", "b", "c", "d", "e"};
+  size_t key{};
+  for (size_t i{}; i < copy->GetNrOfNodes(); ++i)
+  {
+    for (XMLAttribute const& attribute : copy->GetNodeByIndex(i).value().get().GetTag().attributes)
+    {
+      EXPECT_EQ(attribute.key, keys[key++]);
+    }
+  }
+  EXPECT_EQ(key, keys.size());
+  EXPECT_TRUE(copy->GetNodeByIndex(2).value().get().GetTag().attributes.empty());
+  EXPECT_THROW(copy->GetNodeByIndex(1).value().get().GetTag().attributes.at("a"), std::out_of_range);
+
+  EXPECT_FALSE(XMLParser{}.ParseFromMemory("<root a=\"1\" a=\"2\"/>").has_value());
+}
+
+TEST_F(FXMLTests, testParentChildLinks)
+{
+  // Repeated names used to resolve against the first element with that name
+  std::string const xml = "<a><a>x</a><b><a>y</a></b><a>z</a></a>";
+
+  XMLParser parser{};
+  auto ret = parser.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+
+  XMLDocument const& doc = ret.value();
+  ASSERT_EQ(doc.GetNrOfNodes(), 5);
+
+  std::array<std::string_view, 5> constexpr contents = {"", "x", "", "y", "z"};
+  for (uint32_t i{}; i < doc.GetNrOfNodes(); ++i)
+  {
+    EXPECT_EQ(doc.GetNodeByIndex(i).value().get().GetRawContent(), contents[i]);
+  }
+
+  XMLElement const& root = doc.GetRoot().value();
+  EXPECT_FALSE(doc.GetParent(root).has_value());
+
+  std::vector<uint32_t> children;
+  for (XMLElement const& child : doc.GetChildren(root))
+  {
+    children.push_back(doc.GetIndex(child));
+    EXPECT_EQ(doc.GetIndex(doc.GetParent(child).value()), 0);
+  }
+  EXPECT_EQ(children, (std::vector<uint32_t>{1, 2, 4}));
+
+  XMLElement const& b = doc.GetNodeByIndex(2).value();
+  EXPECT_EQ(doc.GetIndex(doc.GetFirstChild(b).value()), 3);
+  EXPECT_FALSE(doc.GetNextSibling(doc.GetFirstChild(b).value()).has_value());
+
+  EXPECT_FALSE(XMLParser{}.ParseFromMemory("<a><b></a></b>").has_value());
+  EXPECT_FALSE(XMLParser{}.ParseFromMemory("<a><b/>").has_value());
+}
+
+TEST_F(FXMLTests, testParseManySiblings)
+{
+  // End tags used to be resolved with a scan over every element parsed so far. How that scales is measured by BM_Parse in FXML_BENCH,
+  // this checks that wide documents still come out with the right links
+  constexpr uint32_t NR_OF_ITEMS = 80'000;
+  std::string xml = "<root>";
+  for (uint32_t i{}; i < NR_OF_ITEMS; ++i)
+  {
+    xml += "<item id=\"1\">text</item>";
+  }
+  xml += "</root>";
+
+  auto ret = XMLParser{}.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+  XMLDocument const& doc = ret.value();
+  ASSERT_EQ(doc.GetNrOfNodes(), NR_OF_ITEMS + 1);
+
+  XMLElement const& root = doc.GetNodeByIndex(0).value();
+  uint32_t nrOfChildren{};
+  for (XMLElement const& child : doc.GetChildren(root))
+  {
+    EXPECT_EQ(doc.GetIndex(child), ++nrOfChildren);
+  }
+  EXPECT_EQ(nrOfChildren, NR_OF_ITEMS);
+  XMLElement const& last = doc.GetNodeByIndex(NR_OF_ITEMS).value();
+  EXPECT_EQ(&doc.GetParent(last).value().get(), &root);
+  EXPECT_FALSE(doc.GetNextSibling(last).has_value());
+  EXPECT_EQ(last.GetRawContent(), "text");
+}
+
+TEST_F(FXMLTests, testNameIndex)
+{
+  std::string const xml = "<root><item id=\"a\"/><group><item id=\"b\"/></group><item id=\"a\"/><other id=\"a\"/></root>";
+
+  for (bool const buildIndex : {false, true})
+  {
+    XMLParser parser{ParseOptions{.buildIndex = buildIndex}};
+    auto ret = parser.ParseFromMemory(xml);
+    ASSERT_TRUE(ret.has_value());
+
+    XMLDocument& doc = ret.value();
+    EXPECT_EQ(doc.HasIndex(), buildIndex);
+
+    std::vector<uint32_t> items;
+    for (XMLElement const& item : doc.GetNodesByName("item"))
+    {
+      items.push_back(doc.GetIndex(item));
+    }
+    EXPECT_EQ(items, (std::vector<uint32_t>{1, 3, 4}));
+    EXPECT_TRUE(doc.HasIndex());
+
+    std::vector<uint32_t> withIdA;
+    for (XMLElement const& element : doc.GetNodesByAttribute("id", "a"))
+    {
+      withIdA.push_back(doc.GetIndex(element));
+    }
+    EXPECT_EQ(withIdA, (std::vector<uint32_t>{1, 4, 5}));
+
+    EXPECT_TRUE(doc.GetNodesByName("missing").empty());
+    EXPECT_TRUE(doc.GetNodesByAttribute("id", "c").empty());
+    EXPECT_EQ(doc.GetIndex(doc.GetNodeByName("group").value()), 2);
+  }
+}
+
+TEST_F(FXMLTests, testNameInterning)
+{
+  std::string const xml = "<root><item id=\"a\"/><group key=\"b\"><item id=\"c\"/></group><item key=\"d\"/></root>";
+
+  auto ret = XMLParser{}.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+  XMLDocument& doc = ret.value();
+
+  // Dense IDs in order of first appearance, element and attribute names share the table
+  XMLNameTable const& names = doc.GetNames();
+  ASSERT_EQ(names.size(), 5);
+  EXPECT_EQ(names.GetName(0), "root");
+  EXPECT_EQ(names.GetName(1), "item");
+  EXPECT_EQ(names.GetName(2), "id");
+  EXPECT_EQ(names.GetName(3), "group");
+  EXPECT_EQ(names.GetName(4), "key");
+  EXPECT_EQ(doc.GetNameId("missing"), XMLNameTable::INVALID_ID);
+
+  uint32_t const item = doc.GetNameId("item");
+  uint32_t const key = doc.GetNameId("key");
+  for (uint32_t i{}; i < doc.GetNrOfNodes(); ++i)
+  {
+    XMLElement const& element = doc.GetNodeByIndex(i).value();
+    EXPECT_EQ(names.GetName(element.GetNameId()), element.GetTag().name);
+    for (XMLAttribute const& attribute : element.GetTag().attributes)
+    {
+      EXPECT_EQ(names.GetName(doc.GetNameId(attribute.key)), attribute.key);
+    }
+  }
+
+  EXPECT_EQ(doc.GetNodesByName(item).size(), 3);
+  EXPECT_EQ(doc.GetIndex(doc.GetNodeByName(doc.GetNameId("group")).value()), 2);
+  EXPECT_TRUE(doc.GetNodesByName(key).empty());
+  EXPECT_TRUE(doc.GetNodesByName(XMLNameTable::INVALID_ID).empty());
+  EXPECT_FALSE(doc.GetNodeByName(XMLNameTable::INVALID_ID).has_value());
+  EXPECT_EQ(doc.GetAttributeValue(doc.GetNodeByIndex(4).value(), key), "d");
+  EXPECT_FALSE(doc.GetAttributeValue(doc.GetNodeByIndex(4).value(), doc.GetNameId("id")).has_value());
+
+  // A clone, a parallel parse and a reparse all hand out the same IDs
+  XMLDocument const clone = doc.Clone();
+  EXPECT_EQ(clone.GetNameId("group"), 3);
+  EXPECT_EQ(clone.GetNodesByName(item).size(), 3);
+
+  XMLParser parallel{ParseOptions{.threadCount = 4, .minChunkSize = 8}};
+  auto parallelRet = parallel.ParseFromMemory(xml);
+  ASSERT_TRUE(parallelRet.has_value());
+  EXPECT_EQ(parallelRet.value().GetNodesByName(parallelRet.value().GetNameId("item")).size(), 3);
+
+  XMLParser parser{};
+  ASSERT_TRUE(parser.Reparse(doc, xml, XMLEdit{xml.find("<item key"), 0, "<extra id=\"e\"/>"}).has_value());
+  EXPECT_EQ(doc.GetNameId("item"), item);
+  EXPECT_EQ(doc.GetNameId("extra"), 5);
+  EXPECT_EQ(doc.GetNodeByName(doc.GetNameId("extra")).value().get().GetNameId(), 5);
+  EXPECT_EQ(doc.GetNodesByName(item).size(), 3);
+}
+
+struct RecordingHandler : XMLSaxHandler
+{
+  std::vector<std::string> events;
+
+  std::expected<void, XMLError> OnStartElement(std::string_view name, XMLAttributes attributes) override
+  {
+    std::string event = "start:" + std::string(name);
+    for (XMLAttribute const& attribute : attributes)
+    {
+      event += " " + std::string(attribute.key) + "=" + std::string(attribute.value);
+    }
+    events.push_back(event);
+    return {};
+  }
+
+  std::expected<void, XMLError> OnEndElement(std::string_view name) override
+  {
+    events.push_back("end:" + std::string(name));
+    return {};
+  }
+
+  std::expected<void, XMLError> OnText(std::string_view text) override
+  {
+    events.push_back("text:" + std::string(text));
+    return {};
+  }
+
+  std::expected<void, XMLError> OnComment(std::string_view comment) override
+  {
+    events.push_back("comment:" + std::string(comment));
+    return {};
+  }
+};
+
+TEST_F(FXMLTests, testSaxParser)
+{
+  std::vector<std::string> const expected = {"start:root",
+                                             "start:node_one",
+                                             "text:This is an XML Parser",
+                                             "end:node_one",
+                                             "start:node_two empty_attribute= another_attribute=Some Data",
+                                             "comment:<!--This is a comment :)-->",
+                                             "start:name",
+                                             "text:Rhidian",
+                                             "end:name",
+                                             "start:country",
+                                             "text:Belgium",
+                                             "end:country",
+                                             "end:node_two",
+                                             "start:node_three city=Kortrijk",
+                                             "end:node_three",
+                                             "end:root"};
+
+  // Tiny chunks force every kind of token to be cut off at some point
+  for (size_t const chunkSize : {size_t{1}, size_t{7}, size_t{16}, XMLSaxParser::DEFAULT_CHUNK_SIZE})
+  {
+    RecordingHandler handler;
+    auto const ret = XMLSaxParser{chunkSize}.Parse(SIMPLE_DATA_FILEPATH, handler);
+    ASSERT_TRUE(ret.has_value()) << ret.error().what();
+    EXPECT_EQ(handler.events, expected);
+  }
+
+  RecordingHandler handler;
+  EXPECT_TRUE(XMLSaxParser{}.ParseFromMemory("<?xml version=\"1.0\"?><a><b/></a>", handler).has_value());
+  EXPECT_EQ(handler.events, (std::vector<std::string>{"start:a", "start:b", "end:b", "end:a"}));
+
+  EXPECT_FALSE(XMLSaxParser{}.ParseFromMemory("<a><b></a>", handler).has_value());
+  EXPECT_FALSE(XMLSaxParser{}.ParseFromMemory("<a>", handler).has_value());
+  EXPECT_EQ(XMLSaxParser{}.Parse("BlablaBla", handler).error().reason(), ErrorReason::CANNOT_FIND_FILE);
+}
+
+TEST_F(FXMLTests, testCompressedInput)
+{
+  std::ifstream file{std::string(SIMPLE_DATA_FILEPATH), std::ios::binary};
+  std::string const plain{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+  RecordingHandler plainHandler;
+  ASSERT_TRUE(XMLSaxParser{}.ParseFromMemory(plain, plainHandler).has_value());
+
+  // The members file is two gzip members back to back, its size hint only covers the second one so the DOM buffer has to grow
+  std::array<std::pair<std::string_view, Compression>, 4> constexpr files = {{{"test_data/simple_data.xml.gz", Compression::GZIP},
+                                                                             {"test_data/simple_data_members.xml.gz", Compression::GZIP},
+                                                                             {"test_data/simple_data.xml.zst", Compression::ZSTD},
+                                                                             {SIMPLE_DATA_FILEPATH, Compression::NONE}}};
+  for (auto const& [filepath, compression] : files)
+  {
+    if (!XMLCompressedReader::IsSupported(compression))
+    {
+      EXPECT_EQ(XMLParser{}.ParseCompressed(filepath).error().reason(), ErrorReason::INVALID_ARGUMENT);
+      continue;
+    }
+
+    // Tiny blocks and reads keep the decompressor waiting for the reader and the other way around
+    XMLCompressedReader reader{7, 2};
+    ASSERT_TRUE(reader.Open(filepath).has_value()) << filepath;
+    EXPECT_EQ(reader.GetCompression(), compression);
+
+    std::string text;
+    std::array<char, 5> chunk{};
+    while (true)
+    {
+      auto const bytesRead = reader.Read(chunk);
+      ASSERT_TRUE(bytesRead.has_value()) << bytesRead.error().what();
+      if (bytesRead.value() == 0)
+      {
+        break;
+      }
+      text.append(chunk.data(), bytesRead.value());
+    }
+    EXPECT_EQ(text, plain) << filepath;
+
+    auto ret = XMLParser{}.ParseCompressed(filepath);
+    ASSERT_TRUE(ret.has_value()) << ret.error().what();
+    XMLDocument const& doc = ret.value();
+    ASSERT_EQ(doc.GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+    for (uint32_t i{}; i < doc.GetNrOfNodes(); ++i)
+    {
+      EXPECT_EQ(doc.GetNodeByIndex(i).value().get().GetTag().name, SIMPLE_DATA_NODE_NAMES[i]);
+    }
+    EXPECT_EQ(doc.GetNodeByIndex(4).value().get().GetRawContent(), "Belgium");
+    EXPECT_EQ(doc.GetNodeByIndex(2).value().get().GetTag().attributes.at("another_attribute"), "Some Data");
+
+    RecordingHandler handler;
+    ASSERT_TRUE(XMLSaxParser{16}.ParseCompressed(filepath, handler).has_value());
+    EXPECT_EQ(handler.events, plainHandler.events);
+
+    ParseOptions options;
+    options.filter = {"//name"};
+    EXPECT_EQ(XMLParser{options}.ParseCompressed(filepath).value().GetNrOfNodes(), 1);
+  }
+
+  if (XMLCompressedReader::IsSupported(Compression::GZIP))
+  {
+    std::ifstream gzipFile{"test_data/simple_data.xml.gz", std::ios::binary};
+    std::string const gzip{std::istreambuf_iterator<char>{gzipFile}, std::istreambuf_iterator<char>{}};
+
+    std::filesystem::path const path = std::filesystem::temp_directory_path() / "fxml_compressed_test.xml.gz";
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << gzip.substr(0, gzip.size() / 2);
+    EXPECT_EQ(XMLParser{}.ParseCompressed(path.string()).error().reason(), ErrorReason::PARSE_ERROR);
+
+    // A trailer claiming 4 GiB does not get believed for a file this size, the parse fails on the length check instead of allocating
+    std::string oversized = gzip;
+    std::fill(oversized.end() - 4, oversized.end(), '\xff');
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << oversized;
+    XMLCompressedReader reader;
+    ASSERT_TRUE(reader.Open(path.string()).has_value());
+    EXPECT_LE(reader.GetSizeHint(), XMLCompressedReader::DEFAULT_BLOCK_SIZE);
+    reader.Close();
+    EXPECT_EQ(XMLParser{}.ParseCompressed(path.string()).error().reason(), ErrorReason::PARSE_ERROR);
+
+    std::string damaged = gzip;
+    damaged[damaged.size() / 2] ^= 0x55;
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << damaged;
+    RecordingHandler handler;
+    EXPECT_FALSE(XMLSaxParser{}.ParseCompressed(path.string(), handler).has_value());
+    std::filesystem::remove(path);
+  }
+
+  EXPECT_EQ(XMLParser{}.ParseCompressed("BlablaBla").error().reason(), ErrorReason::CANNOT_FIND_FILE);
+}
+
+TEST_F(FXMLTests, testParseWithProlog)
+{
+  XMLParser parser{};
+  auto ret = parser.ParseFromMemory("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<root><child/></root>");
+  ASSERT_TRUE(ret.has_value());
+  EXPECT_EQ(ret.value().GetNrOfNodes(), 2);
+  EXPECT_EQ(ret.value().GetRoot().value().get().GetTag().name, "root");
+}
+
+TEST_F(FXMLTests, testXMLReader)
+{
+  std::string_view const xml =
+      "<?xml version=\"1.0\"?><root><skip a=\"1\"><deep><deeper/></deep><!--<fake>--></skip>"
+      "<keep key=\"value\" other=\"a=b\">Text</keep><empty/></root>";
+
+  XMLReader reader{xml};
+  std::vector<std::string> events;
+  while (true)
+  {
+    auto const ret = reader.Next();
+    ASSERT_TRUE(ret.has_value()) << ret.error().what();
+    if (!ret.value())
+    {
+      break;
+    }
+
+    switch (reader.Type())
+    {
+      case XMLNodeType::START_ELEMENT:
+        events.push_back("start:" + std::string(reader.Name()) + ":" + std::to_string(reader.Depth()));
+        if (reader.Name() == "skip")
+        {
+          ASSERT_TRUE(reader.SkipSubtree().has_value());
+          EXPECT_EQ(reader.Type(), XMLNodeType::END_ELEMENT);
+          EXPECT_EQ(reader.Name(), "skip");
+        }
+        break;
+      case XMLNodeType::END_ELEMENT:
+        events.push_back("end:" + std::string(reader.Name()));
+        break;
+      case XMLNodeType::TEXT:
+        events.push_back("text:" + std::string(reader.Text()));
+        break;
+      default:
+        break;
+    }
+
+    if (reader.Name() == "keep" && reader.Type() == XMLNodeType::START_ELEMENT)
+    {
+      EXPECT_EQ(reader.Attributes().find("other"), "a=b");
+      EXPECT_EQ(std::ranges::distance(reader.Attributes()), 2);
+    }
+  }
+
+  EXPECT_EQ(events, (std::vector<std::string>{"start:root:0", "start:skip:1", "start:keep:1", "text:Text", "end:keep", "start:empty:1", "end:root"}));
+
+  XMLReader unclosed{"<a><b>"};
+  ASSERT_TRUE(unclosed.Next().has_value());
+  ASSERT_TRUE(unclosed.Next().has_value());
+  EXPECT_FALSE(unclosed.SkipSubtree().has_value());
+}
+
+TEST_F(FXMLTests, testParallelParseMatchesSequential)
+{
+  std::string xml = "<?xml version=\"1.0\"?>\n<root>";
+  for (int i{}; i < 2000; ++i)
+  {
+    xml += std::format("<item id=\"{}\" kind=\"k{}\"><!-- <fake id=\"{}\"> --><name>Item {}</name><![CDATA[<not a tag>]]><leaf/></item>\n", i, i % 7, i, i);
+  }
+  xml += "tail</root>";
+  std::string_view const xmlView{xml};
+
+  auto const sequential = XMLParser{}.ParseFromMemory(xmlView);
+  ASSERT_TRUE(sequential.has_value()) << sequential.error().what();
+
+  for (uint32_t const threadCount : {2u, 3u, 8u})
+  {
+    auto const parallel = XMLParser{ParseOptions{.threadCount = threadCount, .minChunkSize = 1}}.ParseFromMemory(xmlView);
+    ASSERT_TRUE(parallel.has_value()) << parallel.error().what();
+
+    XMLDocument const& expected = sequential.value();
+    XMLDocument const& actual = parallel.value();
+    ASSERT_EQ(actual.GetNrOfNodes(), expected.GetNrOfNodes());
+    for (uint32_t i{}; i < expected.GetNrOfNodes(); ++i)
+    {
+      XMLElement const& lhs = expected.GetNodeByIndex(i).value();
+      XMLElement const& rhs = actual.GetNodeByIndex(i).value();
+      ASSERT_EQ(lhs.GetTag().name, rhs.GetTag().name);
+      ASSERT_EQ(lhs.GetRawContent(), rhs.GetRawContent());
+      ASSERT_TRUE(std::ranges::equal(lhs.GetTag().attributes, rhs.GetTag().attributes,
+                                     [](XMLAttribute const& a, XMLAttribute const& b) { return a.key == b.key && a.value == b.value; }));
+
+      auto const indexOf = [](XMLDocument const& doc, auto const& element)
+      { return element.has_value() ? doc.GetIndex(element.value()) : XMLElement::INVALID_INDEX; };
+      ASSERT_EQ(indexOf(expected, expected.GetParent(lhs)), indexOf(actual, actual.GetParent(rhs)));
+      ASSERT_EQ(indexOf(expected, expected.GetFirstChild(lhs)), indexOf(actual, actual.GetFirstChild(rhs)));
+      ASSERT_EQ(indexOf(expected, expected.GetNextSibling(lhs)), indexOf(actual, actual.GetNextSibling(rhs)));
+    }
+  }
+
+  // Errors which only show up across chunks are the same ones as well
+  std::string_view const unclosedXml = xmlView.substr(0, xmlView.size() - std::string_view{"tail</root>"}.size());
+  auto const unclosed = XMLParser{ParseOptions{.threadCount = 4, .minChunkSize = 1}}.ParseFromMemory(unclosedXml);
+  ASSERT_FALSE(unclosed.has_value());
+  EXPECT_EQ(unclosed.error().what(), "EOF reached while tag 'root' is still open");
+}
+
+TEST_F(FXMLTests, testParseMany)
+{
+  std::vector<std::string_view> filepaths(200, SIMPLE_DATA_FILEPATH);
+  filepaths[37] = "BlablaBla";
+
+  XMLBatchParser batchParser{4};
+  EXPECT_EQ(batchParser.GetNrOfThreads(), 4);
+
+  // The same pool and parsers serve every batch
+  for (int batch{}; batch < 3; ++batch)
+  {
+    auto const results = batchParser.ParseMany(filepaths);
+    ASSERT_EQ(results.size(), filepaths.size());
+
+    for (size_t i{}; i < results.size(); ++i)
+    {
+      if (i == 37)
+      {
+        ASSERT_FALSE(results[i].has_value());
+        EXPECT_EQ(results[i].error().reason(), ErrorReason::CANNOT_FIND_FILE);
+        continue;
+      }
+
+      ASSERT_TRUE(results[i].has_value()) << results[i].error().what();
+      EXPECT_EQ(results[i].value().GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+      EXPECT_EQ(results[i].value().GetRoot().value().get().GetTag().name, "root");
+    }
+  }
+
+  EXPECT_TRUE(batchParser.ParseMany(std::span<std::string_view const>{}).empty());
+
+  // Every worker allocates from the one arena
+  XMLArena arena;
+  auto const arenaResults = XMLBatchParser{4, ParseOptions{.memoryResource = &arena}}.ParseMany(std::span{filepaths}.first(37));
+  EXPECT_TRUE(std::ranges::all_of(arenaResults, [](auto const& result) { return result.has_value() && result->GetNrOfNodes() == 6; }));
+  EXPECT_GT(arena.GetBytesUsed(), 0);
+}
+
+TEST_F(FXMLTests, testReuseParser)
+{
+  XMLParser parser{};
+  EXPECT_FALSE(parser.ParseFromMemory("<a><b>").has_value());
+
+  // Nothing of the failed parse carries over, and the first document outlives the second parse
+  auto first = parser.Parse(SIMPLE_DATA_FILEPATH);
+  auto second = parser.ParseFromMemory("<c/>");
+  ASSERT_TRUE(first.has_value());
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ(first.value().GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+  EXPECT_EQ(second.value().GetNrOfNodes(), 1);
+  EXPECT_EQ(first.value().GetRoot().value().get().GetTag().name, "root");
+
+  std::vector<char> buffer(4096, 'x');
+  auto third = parser.Parse(SIMPLE_DATA_FILEPATH, Buffer{buffer.data(), buffer.size()});
+  ASSERT_TRUE(third.has_value()) << third.error().what();
+  EXPECT_EQ(third.value().GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+}
+
+// Counts what the arena asks of the heap
+struct CountingResource : std::pmr::memory_resource
+{
+  size_t nrOfAllocations = 0;
+
+  void* do_allocate(size_t bytes, size_t alignment) override
+  {
+    ++nrOfAllocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+TEST_F(FXMLTests, testArenaReuse)
+{
+  std::string xml = "<root>";
+  for (int i{}; i < 5000; ++i)
+  {
+    xml += std::format("<item id=\"{}\" kind=\"value\">Item {}</item>", i, i);
+  }
+  xml += "</root>";
+
+  CountingResource upstream;
+  XMLArena arena{4096, &upstream};
+  XMLParser parser{ParseOptions{.memoryResource = &arena}};
+
+  size_t nrOfAllocations{};
+  for (int round{}; round < 4; ++round)
+  {
+    {
+      auto const ret = parser.ParseFromMemory(xml);
+      ASSERT_TRUE(ret.has_value());
+      EXPECT_EQ(ret.value().GetNrOfNodes(), 5001);
+      EXPECT_EQ(ret.value().GetNodeByIndex(5000).value().get().GetTag().attributes.at("id"), "4999");
+    }
+    arena.Reset();
+
+    // The first round warms the arena up, after that the heap is left alone
+    if (round > 0)
+    {
+      EXPECT_EQ(upstream.nrOfAllocations, nrOfAllocations);
+    }
+    nrOfAllocations = upstream.nrOfAllocations;
+  }
+
+  EXPECT_EQ(arena.GetBytesUsed(), 0);
+  EXPECT_GT(arena.GetCapacity(), 0);
+}
+
+TEST_F(FXMLTests, testDocumentOwnsSource)
+{
+  static_assert(!std::is_copy_constructible_v<XMLDocument>);
+  static_assert(std::is_nothrow_move_constructible_v<XMLDocument>);
+
+  // Neither the parser nor the mapping outlive the parse call, the document keeps the mapping alive by itself
+  std::optional<XMLDocument> mapped;
+  {
+    auto ret = XMLParser{}.Parse(SIMPLE_DATA_FILEPATH, MemoryMap{});
+    ASSERT_TRUE(ret.has_value());
+    mapped = std::move(ret.value());
+  }
+  EXPECT_EQ(mapped->GetNodeByName("name").value().get().GetRawContent(), "Rhidian");
+
+  // A clone has its own copy of the text
+  XMLDocument const clone = mapped->Clone();
+  mapped.reset();
+  EXPECT_EQ(clone.GetNrOfNodes(), SIMPLE_DATA_NODE_NAMES.size());
+  EXPECT_EQ(clone.GetNodeByIndex(5).value().get().GetTag().attributes.at("city"), "Kortrijk");
+
+  // A caller buffer with a release function is handed back once the document is done with it, also when the parse fails
+  int nrOfReleases{};
+  auto const release = [&nrOfReleases](char* buffer, size_t)
+  {
+    delete[] buffer;
+    ++nrOfReleases;
+  };
+  {
+    auto ret = XMLParser{}.Parse(SIMPLE_DATA_FILEPATH, Buffer{new char[4096], 4096, release});
+    ASSERT_TRUE(ret.has_value());
+    EXPECT_EQ(nrOfReleases, 0);
+  }
+  EXPECT_EQ(nrOfReleases, 1);
+  EXPECT_FALSE(XMLParser{}.Parse(SIMPLE_DATA_FILEPATH, Buffer{new char[8], 8, release}).has_value());
+  EXPECT_EQ(nrOfReleases, 2);
+}
+
+TEST_F(FXMLTests, testDecodeReferences)
+{
+  std::string_view const xml =
+      "<root><plain a=\"no entities\">Nothing to decode</plain><encoded a=\"&quot;x&quot; &amp; y\">1 &lt; 2 &#65;&#x42;&#x20AC; &unknown; &#xZZ; &</encoded>"
+      "<literal><![CDATA[&amp; stays]]></literal></root>";
+
+  auto ret = XMLParser{}.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value());
+  XMLDocument const& doc = ret.value();
+
+  // Untouched text comes back as the very same view
+  XMLElement const& plain = doc.GetNodeByIndex(1).value();
+  EXPECT_EQ(doc.GetContent(plain).data(), plain.GetRawContent().data());
+  EXPECT_EQ(doc.GetAttributeValue(plain, "a").value().data(), plain.GetTag().attributes.at("a").data());
+
+  XMLElement const& encoded = doc.GetNodeByIndex(2).value();
+  EXPECT_EQ(doc.GetContent(encoded), "1 < 2 AB\xE2\x82\xAC &unknown; &#xZZ; &");
+  EXPECT_EQ(doc.GetAttributeValue(encoded, "a"), "\"x\" & y");
+  EXPECT_FALSE(doc.GetAttributeValue(encoded, "b").has_value());
+
+  // Decoded once, every later access gets the cached text
+  EXPECT_EQ(doc.GetContent(encoded).data(), doc.GetContent(encoded).data());
+
+  EXPECT_EQ(doc.GetContent(doc.GetNodeByIndex(3).value()), "&amp; stays");
+}
+
+TEST_F(FXMLTests, testQuery)
+{
+  auto ret = XMLParser{}.Parse(SIMPLE_DATA_FILEPATH);
+  ASSERT_TRUE(ret.has_value());
+  XMLDocument const& doc = ret.value();
+
+  auto const query = XMLQuery::Compile("/root/node_two/name");
+  ASSERT_TRUE(query.has_value());
+  EXPECT_EQ(query.value().First(doc).value().get().GetRawContent(), "Rhidian");
+
+  auto const count = [&doc](std::string_view expression)
+  {
+    auto const compiled = XMLQuery::Compile(expression);
+    EXPECT_TRUE(compiled.has_value()) << expression;
+    return compiled.has_value() ? compiled.value().Count(doc) : 0;
+  };
+  EXPECT_EQ(count("//name"), 1);
+  EXPECT_EQ(count("country"), 1);
+  EXPECT_EQ(count("/node_two"), 0);
+  EXPECT_EQ(count("/root/*"), 3);
+  EXPECT_EQ(count("/root//*"), 5);
+  EXPECT_EQ(count("//*[@city='Kortrijk']"), 1);
+  EXPECT_EQ(count("//*[@city=\"Brussels\"]"), 0);
+  EXPECT_EQ(count("//node_two[@empty_attribute][@another_attribute]/country"), 1);
+  EXPECT_EQ(count("/root/*[2]"), 1);
+  EXPECT_EQ(XMLQuery::Compile("/root/*[2]").value().First(doc).value().get().GetTag().name, "node_two");
+  EXPECT_EQ(count("/root/*[4]"), 0);
+  EXPECT_EQ(count("/root[1]//country"), 1);
+  EXPECT_EQ(count("/root/unknown/name"), 0);
+
+  // The name index gives the same answers
+  doc.BuildIndex();
+  EXPECT_EQ(count("//name"), 1);
+  EXPECT_EQ(count("/root//*"), 5);
+
+  for (std::string_view const malformed : {"", "/", "/root/", "//a[", "//a[@]", "//a[@b=c]", "//a[0]", "//a[1][@b]", "a]"})
+  {
+    EXPECT_FALSE(XMLQuery::Compile(malformed).has_value()) << malformed;
+  }
+
+  // Attribute values are compared after decoding, names resolve per document and long queries work past the inline name IDs
+  auto const refs = XMLParser{}.ParseFromMemory("<a><b v='x&amp;y'/><b v='x&amp;'/><b v='&#120;'/><b v='x&y'/></a>");
+  ASSERT_TRUE(refs.has_value());
+  EXPECT_EQ(XMLQuery::Compile("//b[@v='x&y']").value().Count(refs.value()), 2);
+  EXPECT_EQ(XMLQuery::Compile("//b[@v='x&']").value().Count(refs.value()), 1);
+  EXPECT_EQ(XMLQuery::Compile("//b[@v='x']").value().Count(refs.value()), 1);
+  EXPECT_EQ(XMLQuery::Compile("//b[@v='x&yz']").value().Count(refs.value()), 0);
+  EXPECT_EQ(XMLQuery::Compile("/root/node_two").value().Count(refs.value()), 0);
+
+  auto const deep = XMLParser{}.ParseFromMemory("<a><a><a><a><a><a><a><a><a><a/></a></a></a></a></a></a></a></a></a>");
+  ASSERT_TRUE(deep.has_value());
+  EXPECT_EQ(XMLQuery::Compile("/a/a/a/a/a/a/a/a/a/a").value().Count(deep.value()), 1);
+  EXPECT_EQ(XMLQuery::Compile("/a/a/a/a/a/a/a/a/a/*").value().Count(deep.value()), 1);
+  EXPECT_EQ(XMLQuery::Compile("//a/a/a/a/a/a/a/a/a").value().Count(deep.value()), 2);
+}
+
+TEST_F(FXMLTests, testFilteredParse)
+{
+  std::string const xml =
+      "<?xml version=\"1.0\"?><catalog><record id=\"1\"><price currency=\"EUR\">10</price><!-- <price>no</price> --></record>"
+      "<skipped a='<' b=\"x\"><price>20</price><![CDATA[<price>]]></skipped><record id=\"2\"><price>30<sub/></price><name>n</name></record>"
+      "<record/></catalog>";
+
+  auto const parse = [&xml](std::vector<std::string> filter)
+  {
+    ParseOptions options;
+    options.filter = std::move(filter);
+    return XMLParser{options}.ParseFromMemory(xml);
+  };
+
+  // Matches become the top-level elements, in document order and with their whole subtree
+  auto ret = parse({"/catalog/record/price"});
+  ASSERT_TRUE(ret.has_value()) << ret.error().what();
+  XMLDocument const& doc = ret.value();
+  ASSERT_EQ(doc.GetNrOfNodes(), 3);
+  EXPECT_EQ(doc.GetNodeByIndex(0).value().get().GetRawContent(), "10");
+  EXPECT_EQ(doc.GetNodeByIndex(0).value().get().GetTag().attributes.at("currency"), "EUR");
+  EXPECT_FALSE(doc.GetParent(doc.GetNodeByIndex(0).value()).has_value());
+  EXPECT_EQ(doc.GetNextSibling(doc.GetNodeByIndex(0).value()).value().get().GetRawContent(), "30");
+  EXPECT_EQ(doc.GetNodeByIndex(2).value().get().GetTag().name, "sub");
+  EXPECT_EQ(doc.GetParent(doc.GetNodeByIndex(2).value()).value().get().GetRawContent(), "30");
+
+  EXPECT_EQ(parse({"//price"}).value().GetNrOfNodes(), 4);
+  EXPECT_EQ(parse({"price", "name"}).value().GetNrOfNodes(), 5);
+  EXPECT_EQ(parse({"/catalog/*"}).value().GetNrOfNodes(), 9);
+  EXPECT_EQ(parse({"//record"}).value().GetNrOfNodes(), 7);
+  EXPECT_EQ(parse({"/record"}).value().GetNrOfNodes(), 0);
+  EXPECT_EQ(parse({"/catalog//sub"}).value().GetNrOfNodes(), 1);
+
+  // Skipped parts are still checked for tag nesting, predicates are refused
+  ParseOptions options;
+  options.filter = {"//price"};
+  XMLParser parser{options};
+  EXPECT_FALSE(parser.ParseFromMemory("<a><b></a>").has_value());
+  EXPECT_FALSE(parser.ParseFromMemory("<a><b>").has_value());
+  EXPECT_FALSE(parser.ParseFromMemory("<a><price>").has_value());
+  EXPECT_EQ(parser.ParseFromMemory("<a><price/></a>").value().GetNrOfNodes(), 1);
+  EXPECT_EQ(parse({"//price[@currency]"}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_FALSE(parse({"/catalog/"}).has_value());
+}
+
+TEST_F(FXMLTests, testSchemaBinding)
+{
+  std::string_view const xml = R"(<?xml version="1.0"?>
+<config version="3" unknown="x">
+  <name>Tom &amp; Jerry</name>
+  <rawName>Tom &amp; Jerry</rawName>
+  <ratio> 0.25 </ratio>
+  <enabled>true</enabled>
+  <!-- <name>not this one</name> -->
+  <unbound><name>nor this one</name></unbound>
+  <primary host="localhost"><port>8080</port></primary>
+  <server host="a"><port>1</port></server>
+  <server host="b"><port>2</port></server>
+  <id>4</id><id>5</id><id>6</id>
+</config>)";
+
+  auto const config = ParseInto<BoundConfig>(xml);
+  ASSERT_TRUE(config.has_value()) << config.error().what();
+  EXPECT_EQ(config->name, "Tom & Jerry");
+  EXPECT_EQ(config->rawName, "Tom &amp; Jerry");
+  EXPECT_EQ(config->version, 3);
+  EXPECT_EQ(config->ratio, 0.25);
+  EXPECT_TRUE(config->enabled);
+  EXPECT_EQ(config->primary.host, "localhost");
+  EXPECT_EQ(config->primary.port, 8080);
+  ASSERT_EQ(config->servers.size(), 2);
+  EXPECT_EQ(config->servers[1].host, "b");
+  EXPECT_EQ(config->servers[1].port, 2);
+  EXPECT_EQ(config->ids, (std::vector<int>{4, 5, 6}));
+
+  // A bound member gets all the text of its element at once, however many pieces comments and CDATA sections cut it into
+  auto const split = ParseInto<BoundConfig>("<config><name>a<![CDATA[&b]]>&amp;c</name><id>1<!-- c -->2</id><id>3</id></config>");
+  ASSERT_TRUE(split.has_value()) << split.error().what();
+  EXPECT_EQ(split->name, "a&b&c");
+  EXPECT_EQ(split->ids, (std::vector<int>{12, 3}));
+  EXPECT_EQ(ParseInto<BoundConfig>("<config><name>x</name><name></name></config>").value().name, "");
+  EXPECT_FALSE(ParseInto<BoundConfig>("<config><id></id></config>").has_value());
+  EXPECT_FALSE(ParseInto<BoundConfig>("<config><rawName>a<!-- c -->b</rawName></config>").has_value());
+
+  EXPECT_FALSE(ParseInto<BoundConfig>("<config><ratio>abc</ratio></config>").has_value());
+  EXPECT_FALSE(ParseInto<BoundConfig>("<config><primary><port>70000</port></primary></config>").has_value());
+  EXPECT_FALSE(ParseInto<BoundConfig>("<other/>").has_value());
+  EXPECT_FALSE(ParseInto<BoundConfig>("<config><name></config>").has_value());
+  EXPECT_FALSE(ParseInto<BoundConfig>("").has_value());
+}
+
+TEST_F(FXMLTests, testDocumentCache)
+{
+  std::filesystem::path const path = std::filesystem::temp_directory_path() / "fxml_cache_test.xml";
+  auto const writeFile = [&path](std::string_view xml) { std::ofstream{path, std::ios::binary | std::ios::trunc} << xml; };
+  writeFile("<config><port>80</port></config>");
+
+  XMLDocumentCache cache;
+  auto first = cache.Get(path.string());
+  ASSERT_TRUE(first.has_value()) << first.error().what();
+  auto second = cache.Get(path.string());
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ(first.value().get(), second.value().get());
+
+  // Size changed, parsed again. The old document stays usable
+  writeFile("<config><port>8080</port></config>");
+  auto third = cache.Get(path.string());
+  ASSERT_TRUE(third.has_value());
+  EXPECT_NE(first.value().get(), third.value().get());
+  EXPECT_EQ(third.value()->GetContent(third.value()->GetNodeByIndex(1).value()), "8080");
+  EXPECT_EQ(first.value()->GetContent(first.value()->GetNodeByIndex(1).value()), "80");
+  EXPECT_EQ(cache.GetNrOfDocuments(), 1);
+
+  // Every thread gets the document of the one parse
+  cache.Clear();
+  std::array<XMLDocumentCache::DocumentPtr, 8> shared;
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i{}; i < shared.size(); ++i)
+    {
+      threads.emplace_back([&, i]() { shared[i] = cache.Get(path.string()).value_or(nullptr); });
+    }
+  }
+  ASSERT_NE(shared[0], nullptr);
+  EXPECT_TRUE(std::ranges::all_of(shared, [&shared](auto const& document) { return document == shared[0]; }));
+
+  // Readers of a shared document only ever read, its index is there before the first of them gets it
+  ASSERT_TRUE(shared[0]->HasIndex());
+  {
+    std::array<size_t, 8> nrOfPorts{};
+    std::vector<std::jthread> threads;
+    for (size_t i{}; i < nrOfPorts.size(); ++i)
+    {
+      threads.emplace_back(
+          [&, i]()
+          {
+            for (int j{}; j < 100; ++j)
+            {
+              nrOfPorts[i] += shared[i]->GetNodesByName("port").size();
+            }
+          });
+    }
+    threads.clear();
+    EXPECT_TRUE(std::ranges::all_of(nrOfPorts, [](size_t count) { return count == 100; }));
+  }
+
+  writeFile("<config><port>");
+  EXPECT_FALSE(cache.Get(path.string()).has_value());
+  EXPECT_EQ(cache.GetNrOfDocuments(), 0);
+
+  std::filesystem::remove(path);
+  EXPECT_FALSE(cache.Get(path.string()).has_value());
+
+#ifdef __linux__
+  // Same size and write time, only the watch can tell it changed
+  writeFile("<config><port>80</port></config>");
+  XMLDocumentCache watchingCache{{}, true};
+  ASSERT_TRUE(watchingCache.IsWatchingFiles());
+  auto watched = watchingCache.Get(path.string());
+  ASSERT_TRUE(watched.has_value());
+
+  auto const lastWriteTime = std::filesystem::last_write_time(path);
+  writeFile("<config><port>81</port></config>");
+  std::filesystem::last_write_time(path, lastWriteTime);
+
+  bool reloaded{false};
+  for (int i{}; i < 200 && !reloaded; ++i)
+  {
+    auto current = watchingCache.Get(path.string());
+    ASSERT_TRUE(current.has_value());
+    reloaded = current.value() != watched.value();
+    if (!reloaded)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    else
+    {
+      EXPECT_EQ(current.value()->GetContent(current.value()->GetNodeByIndex(1).value()), "81");
+    }
+  }
+  EXPECT_TRUE(reloaded);
+  std::filesystem::remove(path);
+#endif
+}
+
+TEST_F(FXMLTests, testIncrementalReparse)
+{
+  std::string const original = "<root><a x=\"1\"><b>old</b><c y=\"2\"/><!-- c --></a><d z=\"3\">tail &amp; more</d></root>";
+
+  // Every edit must end up with the same document as parsing the edited text from scratch
+  auto const expectReparsed = [&original](XMLEdit const& edit)
+  {
+    std::string edited = original;
+    edited.replace(edit.offset, edit.length, edit.replacement);
+
+    auto parsed = XMLParser{}.ParseFromMemory(original);
+    ASSERT_TRUE(parsed.has_value());
+    XMLDocument doc{std::move(parsed.value())};
+    doc.BuildIndex();
+
+    XMLParser parser{};
+    auto const ret = parser.Reparse(doc, original, edit);
+    ASSERT_TRUE(ret.has_value()) << ret.error().what();
+
+    auto expected = XMLParser{}.ParseFromMemory(edited);
+    ASSERT_TRUE(expected.has_value());
+    XMLDocument const& full = expected.value();
+
+    ASSERT_EQ(doc.GetNrOfNodes(), full.GetNrOfNodes()) << edited;
+    for (uint32_t i{}; i < full.GetNrOfNodes(); ++i)
+    {
+      XMLElement const& actual = doc.GetNodeByIndex(i).value();
+      XMLElement const& wanted = full.GetNodeByIndex(i).value();
+      EXPECT_EQ(actual.GetTag().name, wanted.GetTag().name) << edited;
+      EXPECT_EQ(doc.GetContent(actual), full.GetContent(wanted)) << edited;
+      EXPECT_EQ(doc.GetParent(actual).has_value() ? doc.GetIndex(doc.GetParent(actual).value()) : XMLElement::INVALID_INDEX,
+                full.GetParent(wanted).has_value() ? full.GetIndex(full.GetParent(wanted).value()) : XMLElement::INVALID_INDEX);
+      EXPECT_EQ(doc.GetNextSibling(actual).has_value() ? doc.GetIndex(doc.GetNextSibling(actual).value()) : XMLElement::INVALID_INDEX,
+                full.GetNextSibling(wanted).has_value() ? full.GetIndex(full.GetNextSibling(wanted).value()) : XMLElement::INVALID_INDEX);
+      ASSERT_EQ(actual.GetTag().attributes.size(), wanted.GetTag().attributes.size()) << edited;
+      for (XMLAttribute const& attribute : wanted.GetTag().attributes)
+      {
+        EXPECT_EQ(actual.GetTag().attributes.find(attribute.key), attribute.value) << edited;
+      }
+    }
+    EXPECT_EQ(doc.GetNodesByName("d").size(), 1);
+  };
+
+  // Content of <b>
+  expectReparsed(XMLEdit{original.find("old"), 3, "brand new"});
+  // Attribute of <c>, <a> gets parsed again
+  expectReparsed(XMLEdit{original.find("y=\"2\"") + 3, 1, "22"});
+  // New elements in front of others
+  expectReparsed(XMLEdit{original.find("<c"), 0, "<e k=\"v\"><f/></e>"});
+  // Children of <a> removed
+  expectReparsed(XMLEdit{original.find("<b>"), original.find("<d") - original.find("<b>") - 4, ""});
+  // Start tag of <a>
+  expectReparsed(XMLEdit{original.find("x=\"1\""), 5, "x=\"one\" w=\"0\""});
+  // Behind the root, parsed from scratch
+  expectReparsed(XMLEdit{original.size(), 0, "<!-- trailing -->"});
+  // Comment closed by one that was already there
+  expectReparsed(XMLEdit{original.find("<c"), 0, "<!-- "});
+
+  // Once edited the document owns its text, later edits need no text passed in
+  XMLParser parser{};
+  auto parsed = parser.ParseFromMemory(original);
+  ASSERT_TRUE(parsed.has_value());
+  XMLDocument doc{std::move(parsed.value())};
+  EXPECT_EQ(parser.Reparse(doc, XMLEdit{0, 0, ""}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_EQ(parser.Reparse(doc, std::string_view{"<root/>"}, XMLEdit{0, 0, ""}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  ASSERT_TRUE(parser.Reparse(doc, original, XMLEdit{original.find("old"), 3, "one"}).has_value());
+  ASSERT_TRUE(parser.Reparse(doc, XMLEdit{original.find("old"), 3, "two"}).has_value());
+  EXPECT_EQ(doc.GetContent(doc.GetNodeByIndex(2).value()), "two");
+
+  // Broken edits leave the document alone
+  EXPECT_EQ(parser.Reparse(doc, XMLEdit{original.size(), 1, ""}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_FALSE(parser.Reparse(doc, XMLEdit{original.find("</b>"), 4, ""}).has_value());
+  EXPECT_EQ(doc.GetContent(doc.GetNodeByIndex(2).value()), "two");
+
+  // A filtered document only holds part of the tree, no parser can splice into it
+  ParseOptions options;
+  options.filter = {"//c"};
+  auto filtered = XMLParser{options}.ParseFromMemory(original);
+  ASSERT_TRUE(filtered.has_value());
+  EXPECT_EQ(parser.Reparse(filtered.value(), original, XMLEdit{original.find("old"), 3, "one"}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_EQ(XMLParser{options}.Reparse(doc, XMLEdit{original.find("old"), 3, "one"}).error().reason(), ErrorReason::INVALID_ARGUMENT);
+}
+
+TEST_F(FXMLTests, testSnapshot)
+{
+  std::filesystem::path const sourcePath = std::filesystem::temp_directory_path() / "fxml_snapshot_test.xml";
+  std::filesystem::path const snapshotPath = std::filesystem::temp_directory_path() / "fxml_snapshot_test.fxmls";
+  auto const writeFile = [](std::filesystem::path const& path, std::string_view data)
+  { std::ofstream{path, std::ios::binary | std::ios::trunc} << data; };
+  std::filesystem::remove(snapshotPath);
+
+  std::string const xml = "<root><a x=\"1\" y=\"\"><b>text</b><!-- note --></a><c/><d>&lt;tail&gt;</d></root>";
+  writeFile(sourcePath, xml);
+
+  auto parsed = XMLParser{}.Parse(sourcePath.string());
+  ASSERT_TRUE(parsed.has_value());
+  XMLDocument const& reference = parsed.value();
+
+  // No snapshot yet, parsed and written
+  auto first = XMLSnapshot::LoadOrParse(sourcePath.string(), snapshotPath.string());
+  ASSERT_TRUE(first.has_value()) << first.error().what();
+  ASSERT_TRUE(std::filesystem::exists(snapshotPath));
+
+  auto loaded = XMLSnapshot::Load(snapshotPath.string(), xml.size(), XMLSnapshot::Checksum(xml));
+  ASSERT_TRUE(loaded.has_value()) << loaded.error().what();
+  XMLDocument const& doc = loaded.value();
+  ASSERT_EQ(doc.GetNrOfNodes(), reference.GetNrOfNodes());
+  for (uint32_t i{}; i < reference.GetNrOfNodes(); ++i)
+  {
+    XMLElement const& actual = doc.GetNodeByIndex(i).value();
+    XMLElement const& wanted = reference.GetNodeByIndex(i).value();
+    EXPECT_EQ(actual.GetTag().name, wanted.GetTag().name);
+    EXPECT_EQ(doc.GetContent(actual), reference.GetContent(wanted));
+    EXPECT_EQ(doc.GetParent(actual).has_value(), reference.GetParent(wanted).has_value());
+    ASSERT_EQ(actual.GetTag().attributes.size(), wanted.GetTag().attributes.size());
+    for (XMLAttribute const& attribute : wanted.GetTag().attributes)
+    {
+      EXPECT_EQ(actual.GetTag().attributes.find(attribute.key), attribute.value);
+    }
+  }
+  EXPECT_EQ(doc.GetNodesByName("b").size(), 1);
+  EXPECT_EQ(doc.GetContent(*doc.GetNodesByName("d").begin()), "<tail>");
+
+  // Same size, different text: the checksum notices, the source gets parsed and the snapshot replaced
+  std::string changed = xml;
+  changed.replace(changed.find("text"), 4, "TEXT");
+  writeFile(sourcePath, changed);
+  EXPECT_EQ(XMLSnapshot::Load(snapshotPath.string(), changed.size(), XMLSnapshot::Checksum(changed)).error().reason(), ErrorReason::INVALID_SNAPSHOT);
+
+  auto reparsed = XMLSnapshot::LoadOrParse(sourcePath.string(), snapshotPath.string());
+  ASSERT_TRUE(reparsed.has_value());
+  EXPECT_EQ(reparsed.value().GetContent(*reparsed.value().GetNodesByName("b").begin()), "TEXT");
+  EXPECT_TRUE(XMLSnapshot::Load(snapshotPath.string(), changed.size(), XMLSnapshot::Checksum(changed)).has_value());
+
+  // A damaged snapshot is refused, never trusted
+  std::filesystem::resize_file(snapshotPath, std::filesystem::file_size(snapshotPath) - 1);
+  EXPECT_EQ(XMLSnapshot::Load(snapshotPath.string(), changed.size(), XMLSnapshot::Checksum(changed)).error().reason(), ErrorReason::INVALID_SNAPSHOT);
+  writeFile(snapshotPath, "garbage, but long enough to hold a header of a snapshot");
+  EXPECT_EQ(XMLSnapshot::Load(snapshotPath.string(), changed.size(), XMLSnapshot::Checksum(changed)).error().reason(), ErrorReason::INVALID_SNAPSHOT);
+  EXPECT_TRUE(XMLSnapshot::LoadOrParse(sourcePath.string(), snapshotPath.string()).has_value());
+
+  // Documents parsed from memory need the text they point into
+  auto fromMemory = XMLParser{}.ParseFromMemory(xml);
+  ASSERT_TRUE(fromMemory.has_value());
+  EXPECT_EQ(XMLSnapshot::Write(fromMemory.value(), snapshotPath.string()).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_EQ(XMLSnapshot::Write(fromMemory.value(), changed, snapshotPath.string()).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  EXPECT_TRUE(XMLSnapshot::Write(fromMemory.value(), xml, snapshotPath.string()).has_value());
+
+  // Filtered parses leave snapshots alone, an unfiltered load afterwards still gets the whole document
+  writeFile(sourcePath, xml);
+  ParseOptions options;
+  options.filter = {"//b"};
+  auto filtered = XMLSnapshot::LoadOrParse(sourcePath.string(), snapshotPath.string(), options);
+  ASSERT_TRUE(filtered.has_value()) << filtered.error().what();
+  EXPECT_EQ(XMLSnapshot::Write(filtered.value(), snapshotPath.string()).error().reason(), ErrorReason::INVALID_ARGUMENT);
+  auto whole = XMLSnapshot::LoadOrParse(sourcePath.string(), snapshotPath.string());
+  ASSERT_TRUE(whole.has_value());
+  EXPECT_GT(whole.value().GetNrOfNodes(), filtered.value().GetNrOfNodes());
+
+  // Temporary files get a name of their own and none of them is left behind
+  EXPECT_FALSE(std::ranges::any_of(std::filesystem::directory_iterator{snapshotPath.parent_path()},
+                                   [&snapshotPath](std::filesystem::directory_entry const& entry)
+                                   { return entry.path().filename().string().starts_with(snapshotPath.filename().string() + "."); }));
+
+  std::filesystem::remove(sourcePath);
+  std::filesystem::remove(snapshotPath);
+}
+
+#if FXML_ENABLE_INSTRUMENTATION
+TEST_F(FXMLTests, testParseStats)
+{
+  size_t nrOfReports{};
+  XMLParseStats reported{};
+
+  ParseOptions options;
+  options.onStats = [&](XMLParseStats const& stats)
+  {
+    ++nrOfReports;
+    reported = stats;
+  };
+  XMLParser parser{options};
+
+  std::string_view const xml = "<root><a x=\"1\" y=\"2\"><b>text</b><!-- note --></a><c/></root>";
+  auto ret = parser.ParseFromMemory(xml);
+  ASSERT_TRUE(ret.has_value()) << ret.error().what();
+
+  EXPECT_EQ(nrOfReports, 1);
+  EXPECT_EQ(reported.nrOfElements, 4);
+  EXPECT_EQ(reported.nrOfAttributes, 2);
+  EXPECT_EQ(reported.nrOfComments, 1);
+  EXPECT_EQ(reported.nrOfTextNodes, 1);
+  EXPECT_EQ(reported.maxDepth, 3);
+  EXPECT_EQ(reported.bytesScanned, xml.size());
+  EXPECT_GE(reported.bytesAllocated, 4 * sizeof(XMLElement));
+  EXPECT_EQ(parser.GetStats().nrOfElements, reported.nrOfElements);
+
+  // Reading the file is timed on its own, and failed parses get reported too
+  ASSERT_TRUE(parser.Parse(SIMPLE_DATA_FILEPATH).has_value());
+  EXPECT_GT(parser.GetStats().loadTime.count(), 0);
+  EXPECT_GT(parser.GetStats().tokenizeTime.count(), 0);
+  EXPECT_EQ(parser.GetStats().nrOfElements, SIMPLE_DATA_NODE_NAMES.size());
+
+  EXPECT_FALSE(parser.ParseFromMemory("<a><b>").has_value());
+  EXPECT_EQ(nrOfReports, 3);
+}
+#endif